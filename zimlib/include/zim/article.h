@@ -85,6 +85,11 @@ namespace zim
                                   : const_cast<File&>(file).getBlob(dirent.getClusterNumber(), dirent.getBlobNumber());
       }
 
+      // Returns length bytes of the data starting at offset. The range is
+      // truncated at the end of the data. For uncompressed clusters only
+      // the requested range is read.
+      Blob getDataRange(offset_type offset, size_type length) const;
+
       offset_type getOffset() const
       {
         Dirent dirent = getDirent();
@@ -94,6 +99,15 @@ namespace zim
                                   : const_cast<File&>(file).getOffset(dirent.getClusterNumber(), dirent.getBlobNumber());
       }
 
+      FileRegion getFileRegion() const
+      {
+        Dirent dirent = getDirent();
+        return dirent.isRedirect()
+            || dirent.isLinktarget()
+            || dirent.isDeleted() ? FileRegion()
+                                  : const_cast<File&>(file).getFileRegion(dirent.getClusterNumber(), dirent.getBlobNumber());
+      }
+
       std::string getPage(bool layout = true, unsigned maxRecurse = 10);
       void getPage(std::ostream&, bool layout = true, unsigned maxRecurse = 10);
 
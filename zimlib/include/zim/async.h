@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_ASYNC_H
+#define ZIM_ASYNC_H
+
+#include <zim/refcounted.h>
+#include <zim/smartptr.h>
+#include <zim/mutex.h>
+#include <exception>
+
+namespace zim
+{
+  class Article;
+  class Blob;
+
+  /**
+   Receives the result of File::getArticleAsync.
+
+   The methods are called in a thread of the executor. Requests complete in
+   no particular order, so the receiver has to be thread safe, when it is
+   used for more than one request.
+   */
+  class ArticleEvent
+  {
+    public:
+      virtual ~ArticleEvent() { }
+
+      // Called with the article and its data. When the article is not
+      // found, article.good() is false. The data of redirects is empty.
+      virtual void onArticle(const Article& article, const Blob& data) = 0;
+      virtual void onError(const std::exception& e) = 0;
+  };
+
+  /**
+   Receives the result of File::getBlobAsync. See ArticleEvent.
+   */
+  class BlobEvent
+  {
+    public:
+      virtual ~BlobEvent() { }
+
+      virtual void onBlob(const Blob& blob) = 0;
+      virtual void onError(const std::exception& e) = 0;
+  };
+
+  /**
+   Base class of work items processed by the executor.
+   */
+  class AsyncJob : public RefCounted
+  {
+    public:
+      enum State
+      {
+        statePending,
+        stateRunning,
+        stateDelivering,
+        stateDone,
+        stateCancelled
+      };
+
+    private:
+      State state;
+      Mutex mutex;
+      Condition finished;
+
+    protected:
+      // Does the actual work. Called in a thread of the executor.
+      virtual void execute() = 0;
+      // Passes the result to the receiver.
+      virtual void deliver() = 0;
+
+    public:
+      AsyncJob()
+        : state(statePending)
+        { }
+
+      void run();
+      bool cancel();
+      void wait();
+      State getState();
+  };
+
+  /**
+   Handle to a running asynchronous request.
+
+   The event receiver passed with the request must be valid until the
+   request is done or successfully cancelled.
+   */
+  class AsyncRequest
+  {
+      SmartPtr<AsyncJob> job;
+
+    public:
+      AsyncRequest()
+        { }
+      explicit AsyncRequest(AsyncJob* job_)
+        : job(job_)
+        { }
+
+      // Cancels the request. After cancel returned true, the receiver is
+      // not called. False is returned, when the result is already being
+      // delivered or is delivered.
+      bool cancel()   { return job && job->cancel(); }
+
+      // Blocks until the request is done or cancelled.
+      void wait()     { if (job) job->wait(); }
+
+      bool isDone()   { return !job || job->getState() >= AsyncJob::stateDone; }
+  };
+
+}
+
+#endif // ZIM_ASYNC_H
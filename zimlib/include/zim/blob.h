@@ -22,15 +22,31 @@
 
 #include <iostream>
 #include <zim/cluster.h>
+#include <zim/bufferpool.h>
+#include <vector>
 #include <algorithm>
 
 namespace zim
 {
+  // Memory owned by blobs, which do not point into a cluster, e.g. when only
+  // a part of a blob is read.
+  class BlobBuffer : public RefCounted
+  {
+      std::vector<char, PoolAllocator<char> > _data;
+
+    public:
+      explicit BlobBuffer(unsigned size)
+        : _data(size)
+        { }
+
+      char* data()  { return _data.empty() ? 0 : &_data[0]; }
+  };
+
   class Blob
   {
       const char* _data;
       unsigned _size;
-      SmartPtr<ClusterImpl> _cluster;
+      SmartPtr<RefCounted> _owner;  // keeps the data alive
 
     public:
       Blob()
@@ -42,10 +58,17 @@ namespace zim
           _size(size)
           { }
 
-      Blob(ClusterImpl* cluster, const char* data, unsigned size)
+      Blob(RefCounted* owner, const char* data, unsigned size)
         : _data(data),
           _size(size),
-          _cluster(cluster)
+          _owner(owner)
+          { }
+
+      // part of another blob sharing its owner
+      Blob(const Blob& blob, unsigned offset, unsigned size)
+        : _data(blob._data + offset),
+          _size(size),
+          _owner(blob._owner)
           { }
 
       const char* data() const  { return _data; }
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_BUFFERPOOL_H
+#define ZIM_BUFFERPOOL_H
+
+#include <cstddef>
+#include <limits>
+#include <new>
+
+namespace zim
+{
+  /**
+   Pool of large memory blocks.
+
+   Blocks are rounded up to size classes and kept in the pool, when they are
+   released, so that the buffer of an evicted cluster is reused for the next
+   one. Small blocks are passed to the global allocator.
+
+   The environment variable ZIM_BUFFERPOOL sets the maximum number of bytes
+   kept in the pool (e.g. "64M"). When ZIM_HUGEPAGES is set to 1, blocks of
+   at least 2MB are mapped with transparent huge pages.
+   */
+  class BufferPool
+  {
+    public:
+      static void* allocate(std::size_t size);
+      static void deallocate(void* p, std::size_t size);
+  };
+
+  /**
+   Allocator for standard containers, which takes large blocks from the
+   BufferPool. Elements, which are created without a value (e.g. by
+   std::vector::resize), are default initialized, so that buffers of
+   chars or integers are not zeroed before they are overwritten.
+   */
+  template <typename T>
+  class PoolAllocator
+  {
+    public:
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef std::size_t size_type;
+      typedef std::ptrdiff_t difference_type;
+
+      template <typename U>
+      struct rebind { typedef PoolAllocator<U> other; };
+
+      PoolAllocator()
+        { }
+      template <typename U>
+      PoolAllocator(const PoolAllocator<U>&)
+        { }
+
+      pointer address(reference x) const              { return &x; }
+      const_pointer address(const_reference x) const  { return &x; }
+
+      pointer allocate(size_type n, const void* = 0)
+        { return static_cast<pointer>(BufferPool::allocate(n * sizeof(T))); }
+      void deallocate(pointer p, size_type n)
+        { BufferPool::deallocate(p, n * sizeof(T)); }
+
+      size_type max_size() const
+        { return std::numeric_limits<size_type>::max() / sizeof(T); }
+
+      template <typename U>
+      void construct(U* p)
+        { ::new(static_cast<void*>(p)) U; }
+      template <typename U, typename V>
+      void construct(U* p, const V& v)
+        { ::new(static_cast<void*>(p)) U(v); }
+      template <typename U>
+      void destroy(U* p)
+        { p->~U(); }
+  };
+
+  template <typename T, typename U>
+  bool operator== (const PoolAllocator<T>&, const PoolAllocator<U>&)
+    { return true; }
+
+  template <typename T, typename U>
+  bool operator!= (const PoolAllocator<T>&, const PoolAllocator<U>&)
+    { return false; }
+
+}
+
+#endif // ZIM_BUFFERPOOL_H
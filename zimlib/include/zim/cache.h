@@ -161,6 +161,9 @@ namespace zim
       /// returns the maximum number of elements in the cache
       size_type getMaxElements() const      { return maxElements; }
 
+      /// returns true, if the key is in the cache without updating statistics
+      bool contains(const Key& key) const   { return data.find(key) != data.end(); }
+
       void setMaxElements(size_type maxElements_)
       {
         size_type numWinners = size() < maxElements / 2 ? size() : maxElements / 2;
@@ -24,7 +24,10 @@
 #include <zim/refcounted.h>
 #include <zim/smartptr.h>
 #include <zim/fstream.h>
+#include <zim/bufferpool.h>
+#include <zim/mutex.h>
 #include <iosfwd>
+#include <string>
 #include <vector>
 
 namespace zim
@@ -36,8 +39,9 @@ namespace zim
   {
       friend std::ostream& operator<< (std::ostream& out, const ClusterImpl& blobImpl);
 
-      typedef std::vector<size_type> Offsets;
-      typedef std::vector<char> Data;
+      // cluster buffers are taken from the buffer pool and are not zeroed
+      typedef std::vector<size_type, PoolAllocator<size_type> > Offsets;
+      typedef std::vector<char, PoolAllocator<char> > Data;
 
       CompressionType compression;
       Offsets offsets;
@@ -45,16 +49,28 @@ namespace zim
       offset_type startOffset;
 
       ifstream* lazy_read_stream;
+      Mutex lazyReadMutex;  // the data is read once by one of the readers
+
+      // uncompressed clusters are used directly from the file mapping
+      SmartPtr<RefCounted> mapping;
+      const char* mappedData;
+
+      // the only blob of the cluster is read from this file, when it is
+      // written (see Cluster::addBlobFile)
+      std::string blobFile;
 
       offset_type read_header(std::istream& in);
       void read_content(std::istream& in);
+      void read_compressed(std::istream& in);
       void write(std::ostream& out) const;
+      void writeBlobFile(std::ostream& out) const;
 
       void set_lazy_read(ifstream* in) {
         lazy_read_stream = in;
       }
 
-      bool is_fully_initialised() const { return lazy_read_stream == 0; }
+      bool is_fully_initialised() const
+        { return __atomic_load_n(&lazy_read_stream, __ATOMIC_ACQUIRE) == 0; }
       void finalise_read();
       const Data& data() const {
         if ( !is_fully_initialised() )
@@ -72,17 +88,23 @@ namespace zim
       bool isCompressed() const                { return compression == zimcompZip || compression == zimcompBzip2 || compression == zimcompLzma; }
 
       size_type getCount() const               { return offsets.size() - 1; }
-      const char* getData(unsigned n) const    { return &data()[ offsets[n] ]; }
+      const char* getData(unsigned n) const
+        { return mappedData ? mappedData + offsets[n] : &data()[ offsets[n] ]; }
       size_type getSize(unsigned n) const      { return offsets[n+1] - offsets[n]; }
-      size_type getSize() const                { return offsets.size() * sizeof(size_type) + data().size(); }
+      size_type getSize() const
+        { return offsets.size() * sizeof(size_type) + (mappedData || !blobFile.empty() ? offsets.back() - offsets.front() : data().size()); }
       offset_type getOffset(size_type n) const { return startOffset + offsets[n]; }
       Blob getBlob(size_type n) const;
+      Blob getBlob(size_type n, offset_type offset, size_type size) const;
       void clear();
 
       void addBlob(const Blob& blob);
       void addBlob(const char* data, unsigned size);
+      void addBlobFile(const std::string& fname, size_type size);
+      bool hasBlobFile() const                 { return !blobFile.empty(); }
 
       void init_from_stream(ifstream& in, offset_type offset);
+      void init_from_buffer(const char* data, offset_type size);
   };
 
   class Cluster
@@ -107,6 +129,9 @@ namespace zim
       size_type getBlobSize(size_type n) const      { return impl->getSize(n); }
       offset_type getBlobOffset(size_type n) const  { return impl->getOffset(n); }
       Blob getBlob(size_type n) const;
+      // Returns a part of a blob. The range is truncated at the end of the
+      // blob. Only the requested range is read from uncompressed clusters.
+      Blob getBlob(size_type n, offset_type offset, size_type size) const;
 
       size_type count() const   { return impl ? impl->getCount() : 0; }
       size_type size() const    { return impl ? impl->getSize(): sizeof(size_type); }
@@ -115,9 +140,26 @@ namespace zim
       void addBlob(const char* data, unsigned size) { getImpl()->addBlob(data, size); }
       void addBlob(const Blob& blob)                { getImpl()->addBlob(blob); }
 
+      // Adds a blob, which is read from the file only, when the cluster is
+      // written, so that it is never held in memory completely. The blob
+      // must be the only one of the cluster.
+      void addBlobFile(const std::string& fname, size_type size)
+        { getImpl()->addBlobFile(fname, size); }
+      bool hasBlobFile() const   { return impl && impl->hasBlobFile(); }
+
       operator bool() const   { return impl; }
 
       void init_from_stream(ifstream& in, offset_type offset);
+      // Reads a cluster from memory. The data starts with the compression
+      // flag; the blobs are copied from it.
+      void init_from_buffer(const char* data, offset_type size);
+
+      // Blobs smaller than this size are copied by getBlob, so that they do
+      // not keep the cluster alive. Blobs of mapped clusters are never
+      // copied. The default is read from the environment variable
+      // ZIM_BLOBCOPYSIZE (0 if not set, which disables copying).
+      static void setBlobCopyThreshold(size_type size);
+      static size_type getBlobCopyThreshold();
   };
 
   std::ostream& operator<< (std::ostream& out, const ClusterImpl& blobImpl);
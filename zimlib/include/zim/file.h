@@ -26,6 +26,7 @@
 #include <zim/fileimpl.h>
 #include <zim/blob.h>
 #include <zim/smartptr.h>
+#include <zim/async.h>
 
 namespace zim
 {
@@ -47,6 +48,10 @@ namespace zim
       offset_type getFilesize() const          { return impl->getFilesize(); }
 
       Dirent getDirent(size_type idx)          { return impl->getDirent(idx); }
+      // Reads many dirents at once. The reads, which are not served from
+      // the cache, are batched, so that they are done in parallel.
+      std::vector<Dirent> getDirents(const std::vector<size_type>& indexes)
+        { return impl->getDirents(indexes); }
       Dirent getDirentByTitle(size_type idx)   { return impl->getDirentByTitle(idx); }
       size_type getCountArticles() const       { return impl->getCountArticles(); }
 
@@ -62,7 +67,25 @@ namespace zim
 
       Blob getBlob(size_type clusterIdx, size_type blobIdx)
         { return getCluster(clusterIdx).getBlob(blobIdx); }
+
+      // Asynchronous variants of getArticle and getBlob. The lookup is done
+      // in a thread pool and the result is passed to the event receiver.
+      // See zim/async.h.
+      AsyncRequest getArticleAsync(char ns, const std::string& url, ArticleEvent& event);
+      AsyncRequest getBlobAsync(size_type clusterIdx, size_type blobIdx, BlobEvent& event);
       offset_type getOffset(size_type clusterIdx, size_type blobIdx);
+      // Returns the location of an uncompressed blob in the file, e.g. for
+      // sendfile. The region is not good(), when the blob is compressed.
+      FileRegion getFileRegion(size_type clusterIdx, size_type blobIdx);
+
+      // Prefetching tells the operating system to read the data of an
+      // article or cluster in the background, so that a later access
+      // finds it already in memory. These methods return immediately.
+      void prefetch(size_type idx)              { impl->prefetchArticle(idx); }
+      void prefetch(char ns, const std::string& url);
+      void prefetchCluster(size_type idx)       { impl->prefetchCluster(idx); }
+      void prefetchClusters(const std::vector<size_type>& indexes)
+        { impl->prefetchClusters(indexes); }
 
       size_type getNamespaceBeginOffset(char ch)
         { return impl->getNamespaceBeginOffset(ch); }
@@ -71,6 +94,9 @@ namespace zim
       size_type getNamespaceCount(char ns)
         { return getNamespaceEndOffset(ns) - getNamespaceBeginOffset(ns); }
 
+      SmartPtr<CompiledTemplate> getLayoutTemplate()
+        { return impl->getLayoutTemplate(); }
+
       std::string getNamespaces()
         { return impl->getNamespaces(); }
       bool hasNamespace(char ch);
@@ -93,7 +119,15 @@ namespace zim
       const std::string& getMimeType(uint16_t idx) const   { return impl->getMimeType(idx); }
 
       std::string getChecksum()   { return impl->getChecksum(); }
-      bool verify()               { return impl->verify(); }
+      bool verify(VerifyProgress* progress = 0)
+        { return impl->verify(progress); }
+
+      size_type getClusterChecksumCount()  { return impl->getClusterChecksumCount(); }
+      bool verifyCluster(size_type idx)    { return impl->verifyCluster(idx); }
+      bool verifyClusters(std::vector<size_type>& corrupt, unsigned threads = 0,
+                          VerifyProgress* progress = 0)
+        { return impl->verifyClusters(corrupt, threads, progress); }
+      void setVerifyClusterReads(bool sw)  { impl->setVerifyClusterReads(sw); }
   };
 
   std::string urldecode(const std::string& url);
@@ -42,6 +42,13 @@ namespace zim
       static const size_type zimVersion;
       static const size_type size;
 
+      // Location of the optional table of cluster checksums. The data is the
+      // number of checksums followed by the CRC32C of the stored bytes of
+      // each cluster, all as 32 bit little endian values. The table does not
+      // cover its own cluster, which is the last one.
+      static const char checksumTableNamespace;
+      static const char checksumTableUrl[];
+
     private:
       Uuid uuid;
       size_type articleCount;
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <limits>
 #include <zim/fstream.h>
 #include <zim/refcounted.h>
 #include <zim/zim.h>
@@ -30,12 +31,67 @@
 #include <zim/cache.h>
 #include <zim/dirent.h>
 #include <zim/cluster.h>
+#include <zim/mutex.h>
+#include <zim/template.h>
+#include <zim/smartptr.h>
 
 namespace zim
 {
+  /**
+   Receives the progress of FileImpl::verify and FileImpl::verifyClusters.
+
+   The method is called in the thread calling verify after each block or
+   cluster of the file is checked.
+   */
+  class VerifyProgress
+  {
+    public:
+      virtual ~VerifyProgress() { }
+
+      virtual void onProgress(offset_type done, offset_type total) = 0;
+  };
+
   class FileImpl : public RefCounted
   {
+      // Detects, whether entries are read in order (e.g. when iterating
+      // over the file) or randomly (e.g. when looking up urls).
+      class AccessTracker
+      {
+          size_type lastIdx;
+          unsigned run;
+
+        public:
+          AccessTracker()
+            : lastIdx(std::numeric_limits<size_type>::max()),
+              run(0)
+            { }
+
+          void access(size_type idx);
+          bool isSequential() const;
+      };
+
+      // A compressed cluster, which is read and uncompressed by one thread
+      // without holding the mutex. Other threads requesting the cluster
+      // wait for the result instead of loading it again.
+      struct ClusterLoad : public RefCounted
+      {
+        Cluster cluster;
+        std::string error;
+        bool done;
+
+        ClusterLoad()
+          : done(false)
+          { }
+      };
+
+      typedef std::map<size_type, SmartPtr<ClusterLoad> > ClusterLoads;
+
       ifstream zimFile;
+      Mutex mutex;  // recursive; guards the stream and the caches
+
+      Mutex loadMutex;  // guards clusterLoads; locked after mutex
+      Condition clusterLoaded;
+      ClusterLoads clusterLoads;
       Fileheader header;
       std::string filename;
 
@@ -48,10 +104,31 @@ namespace zim
 
       std::string namespaces;
 
+      AccessTracker direntAccess;
+      AccessTracker clusterAccess;
+      streambuf::AccessPattern accessPattern;
+      std::vector<offset_type> urlPtrBlock;
+      size_type urlPtrBlockStart;
+
       typedef std::vector<std::string> MimeTypes;
       MimeTypes mimeTypes;
 
+      SmartPtr<CompiledTemplate> layoutTemplate;
+
+      typedef std::vector<uint32_t> ChecksumsType;
+      ChecksumsType clusterChecksums;
+      bool clusterChecksumsRead;
+      bool verifyClusterReads;
+
       offset_type getOffset(offset_type ptrOffset, size_type idx);
+      offset_type getClusterEnd(size_type idx);
+      offset_type getDirentOffset(size_type idx);
+      void updateAccessPattern();
+      void readOffsets(offset_type ptrOffset, const std::vector<size_type>& indexes,
+                       std::vector<offset_type>& offsets);
+      void readClusterChecksums();
+      Cluster loadCluster(size_type idx, offset_type offset, offset_type end,
+                          bool verify, uint32_t checksum);
 
     public:
       explicit FileImpl(const char* fname);
@@ -63,6 +140,7 @@ namespace zim
       offset_type getFilesize() const          { return zimFile.fsize(); }
 
       Dirent getDirent(size_type idx);
+      std::vector<Dirent> getDirents(const std::vector<size_type>& indexes);
       Dirent getDirentByTitle(size_type idx);
       size_type getIndexByTitle(size_type idx);
       size_type getCountArticles() const       { return header.getArticleCount(); }
@@ -71,6 +149,13 @@ namespace zim
       size_type getCountClusters() const       { return header.getClusterCount(); }
       offset_type getClusterOffset(size_type idx)   { return getOffset(header.getClusterPtrPos(), idx); }
 
+      FileRegion getFileRegion(offset_type off, offset_type size)
+        { return zimFile.getFileRegion(off, size); }
+
+      void prefetchArticle(size_type idx);
+      void prefetchCluster(size_type idx);
+      void prefetchClusters(const std::vector<size_type>& indexes);
+
       size_type getNamespaceBeginOffset(char ch);
       size_type getNamespaceEndOffset(char ch);
       size_type getNamespaceCount(char ns)
@@ -81,8 +166,37 @@ namespace zim
 
       const std::string& getMimeType(uint16_t idx) const;
 
+      // Returns the layout page compiled into a template. The page is
+      // parsed on the first call only. Returns a null pointer, when the
+      // file has no layout page.
+      SmartPtr<CompiledTemplate> getLayoutTemplate();
+
+      // Returns the number of clusters covered by the cluster checksum
+      // table or 0, when the file has no table.
+      size_type getClusterChecksumCount();
+
+      // Checks the stored data of a cluster against the checksum table.
+      // Returns true also, when there is no checksum for the cluster.
+      bool verifyCluster(size_type idx);
+
+      // Checks all clusters of the checksum table with the given number of
+      // threads (0 means one per processor). The numbers of the damaged
+      // clusters are stored in corrupt. Returns false, when the file has no
+      // checksum table.
+      bool verifyClusters(std::vector<size_type>& corrupt, unsigned threads = 0,
+                          VerifyProgress* progress = 0);
+
+      // When set, each cluster is checked, when it is read from the file,
+      // and ZimFileFormatError is thrown for damaged clusters. The checksum
+      // is calculated over the data, which is read for uncompressing, so
+      // verified clusters are read completely, even when uncompressed. The default
+      // is read from the environment variable ZIM_VERIFYCLUSTERS.
+      void setVerifyClusterReads(bool sw)   { verifyClusterReads = sw; }
+
       std::string getChecksum();
-      bool verify();
+      // Checks the md5 sum of the file. Returns false, when the file has no
+      // checksum and throws ZimFileFormatError, when the sum is wrong.
+      bool verify(VerifyProgress* progress = 0);
   };
 
 }
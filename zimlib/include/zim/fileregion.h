@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_FILEREGION_H
+#define ZIM_FILEREGION_H
+
+#include <zim/zim.h>
+#include <zim/refcounted.h>
+#include <zim/smartptr.h>
+
+namespace zim
+{
+  /**
+   A range of bytes in an open file.
+
+   A file region is returned for data, which is stored uncompressed in the
+   zim file. It can be passed to sendfile, so that the data is sent without
+   being copied through user space. The file descriptor stays open as long
+   as the region exists.
+   */
+  class FileRegion
+  {
+      SmartPtr<RefCounted> owner;
+      int fd;
+      offset_type offset;
+      offset_type size;
+
+    public:
+      FileRegion()
+        : fd(-1),
+          offset(0),
+          size(0)
+        { }
+
+      FileRegion(RefCounted* owner_, int fd_, offset_type offset_, offset_type size_)
+        : owner(owner_),
+          fd(fd_),
+          offset(offset_),
+          size(size_)
+        { }
+
+      int getFd() const             { return fd; }
+      offset_type getOffset() const { return offset; }
+      offset_type getSize() const   { return size; }
+
+      bool good() const             { return fd >= 0; }
+
+      // Writes the region to the given file descriptor. Uses sendfile where
+      // available and pread/write otherwise. Blocks until all data is
+      // written and returns the number of bytes written.
+      offset_type sendTo(int outFd) const;
+  };
+
+}
+
+#endif // ZIM_FILEREGION_H
@@ -26,17 +26,32 @@
 #include <zim/smartptr.h>
 #include <zim/cache.h>
 #include <zim/refcounted.h>
+#include <zim/mutex.h>
+#include <zim/fileregion.h>
 
 namespace zim
 {
+  class IoUring;
+
   class streambuf : public std::streambuf
   {
+      struct Mapping : public RefCounted
+      {
+        void* address;
+        zim::offset_type size;
+
+        Mapping(int fd, zim::offset_type size);
+        ~Mapping();
+      };
+
       struct FileInfo : public RefCounted
       {
         std::string fname;
         zim::offset_type fsize;
+        SmartPtr<Mapping> mapping;
+        bool mapFailed;
 
-        FileInfo()  { }
+        FileInfo() : mapFailed(false) { }
         FileInfo(const std::string& fname_, int fd);
       };
 
@@ -56,6 +71,7 @@ namespace zim
       typedef Cache<std::string, OpenfileInfoPtr> OpenFilesCacheType;
 
       std::vector<char> buffer;
+      zim::offset_type currentPos;  // file offset of the end of the buffer
 
       FilesType files;
       OpenFilesCacheType openFilesCache;
@@ -66,17 +82,86 @@ namespace zim
       int sync();
 
       void setCurrentFile(const std::string& fname, zim::offset_type off);
+      OpenfileInfoPtr getOpenfile(const std::string& fname);  // mutex must be locked
+      void advise(zim::offset_type off, zim::offset_type count, int advice);
 
       mutable time_t mtime;
 
+      IoUring* ring;
+      bool ringChecked;
+
+      // Guards the open files cache and the ring, since readAt and
+      // readBatch may be called from multiple threads.
+      Mutex mutex;
+
+      IoUring* getRing();  // mutex must be locked
+
+      // no copy allowed
+      streambuf(const streambuf&);
+      streambuf& operator=(const streambuf&);
+
     public:
+      enum AccessPattern
+      {
+        accessNormal,
+        accessSequential,
+        accessRandom
+      };
+
+      // A single read of the batch interface. The number of bytes actually
+      // read is stored in count; it is less than size only at end of file.
+      struct ReadRequest
+      {
+        zim::offset_type offset;
+        char* buffer;
+        unsigned size;
+        unsigned count;
+
+        ReadRequest()
+          : offset(0), buffer(0), size(0), count(0)
+          { }
+        ReadRequest(zim::offset_type offset_, char* buffer_, unsigned size_)
+          : offset(offset_), buffer(buffer_), size(size_), count(0)
+          { }
+      };
+
+      typedef std::vector<ReadRequest> ReadRequests;
+
       streambuf(const std::string& fname, unsigned bufsize, unsigned openFilesCache);
+      ~streambuf();
 
       void seekg(zim::offset_type off);
       void setBufsize(unsigned s)
-      { buffer.resize(s); setg(0, 0, 0);}
+      { if (s != buffer.size()) { buffer.resize(s); setg(0, 0, 0); } }
+      unsigned getBufsize() const
+      { return buffer.size(); }
       zim::offset_type fsize() const;
       time_t getMTime() const;
+
+      // Tells the operating system, that the given range will be read soon.
+      // The call does not block; the data is read in the background.
+      void prefetch(zim::offset_type off, zim::offset_type count);
+
+      // Tells the operating system, how the file is read, so that it can
+      // adapt its readahead. The advice applies to the whole file.
+      void setAccessPattern(AccessPattern pattern);
+
+      // Reads data at the given offset without affecting the stream
+      // position or buffer. Returns the number of bytes read.
+      unsigned readAt(char* buffer, zim::offset_type off, unsigned count);
+
+      // Returns a pointer to the given range of the file mapped read only
+      // into memory or 0, when the range can't be mapped. The mapping is
+      // valid as long as a reference to owner is held.
+      const char* map(zim::offset_type off, zim::offset_type count, SmartPtr<RefCounted>& owner);
+
+      // Returns the file descriptor and offset of the given range. The
+      // region is not good(), when the range spans multiple files.
+      FileRegion getFileRegion(zim::offset_type off, zim::offset_type count);
+
+      // Executes independent reads. When io_uring is enabled, all reads are
+      // submitted with one system call, otherwise they are done with pread.
+      void readBatch(ReadRequests& requests);
   };
 
   class ifstream : public std::istream
@@ -93,8 +178,21 @@ namespace zim
 
       void seekg(zim::offset_type off) { myStreambuf.seekg(off); }
       void setBufsize(unsigned s) { myStreambuf.setBufsize(s); }
+      unsigned getBufsize() const { return myStreambuf.getBufsize(); }
       zim::offset_type fsize() const  { return myStreambuf.fsize(); }
       time_t getMTime() const     { return myStreambuf.getMTime(); }
+      void prefetch(zim::offset_type off, zim::offset_type count)
+        { myStreambuf.prefetch(off, count); }
+      void setAccessPattern(streambuf::AccessPattern pattern)
+        { myStreambuf.setAccessPattern(pattern); }
+      unsigned readAt(char* buffer, zim::offset_type off, unsigned count)
+        { return myStreambuf.readAt(buffer, off, count); }
+      void readBatch(streambuf::ReadRequests& requests)
+        { myStreambuf.readBatch(requests); }
+      const char* map(zim::offset_type off, zim::offset_type count, SmartPtr<RefCounted>& owner)
+        { return myStreambuf.map(off, count, owner); }
+      FileRegion getFileRegion(zim::offset_type off, zim::offset_type count)
+        { return myStreambuf.getFileRegion(off, count); }
   };
 
 }
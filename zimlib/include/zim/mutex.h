@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_MUTEX_H
+#define ZIM_MUTEX_H
+
+#include <zim/noncopyable.h>
+#include <pthread.h>
+
+namespace zim
+{
+  class Mutex : private NonCopyable
+  {
+      friend class Condition;
+
+      pthread_mutex_t mutex;
+
+    public:
+      // A recursive mutex may be locked again by the thread holding it.
+      explicit Mutex(bool recursive = false);
+      ~Mutex();
+
+      void lock();
+      void unlock();
+  };
+
+  class MutexLock : private NonCopyable
+  {
+      Mutex& mutex;
+      bool locked;
+
+    public:
+      explicit MutexLock(Mutex& m)
+        : mutex(m),
+          locked(true)
+        { mutex.lock(); }
+
+      ~MutexLock()
+        { if (locked) mutex.unlock(); }
+
+      void lock()
+        { if (!locked) { mutex.lock(); locked = true; } }
+
+      void unlock()
+        { if (locked) { mutex.unlock(); locked = false; } }
+  };
+
+  class Condition : private NonCopyable
+  {
+      pthread_cond_t cond;
+
+    public:
+      Condition();
+      ~Condition();
+
+      // The mutex must be locked by the caller.
+      void wait(Mutex& mutex);
+      void signal();
+      void broadcast();
+  };
+
+}
+
+#endif // ZIM_MUTEX_H
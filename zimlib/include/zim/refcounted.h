@@ -48,8 +48,10 @@ namespace zim
 
       virtual ~RefCounted()  { }
 
-      virtual unsigned addRef()  { return ++rc; }
-      virtual void release()     { if (--rc == 0) delete this; }
+      // The reference counter is updated atomically, so that objects may be
+      // shared between threads.
+      virtual unsigned addRef()  { return __sync_add_and_fetch(&rc, 1); }
+      virtual void release()     { if (__sync_sub_and_fetch(&rc, 1) == 0) delete this; }
       unsigned refs() const   { return rc; }
   };
 
@@ -21,6 +21,8 @@
 #define ZIM_TEMPLATE_H
 
 #include <string>
+#include <vector>
+#include <zim/refcounted.h>
 
 namespace zim
 {
@@ -78,6 +80,52 @@ namespace zim
 
   };
 
+  /**
+   A template parsed once into a sequence of operations.
+
+   The literal text and the arguments of tokens and links are kept in a
+   single string; the operations reference ranges of it. The well known
+   tokens are resolved at compile time, so that rendering needs no string
+   comparisons.
+   */
+  class CompiledTemplate : public RefCounted
+  {
+    public:
+      enum OpType
+      {
+        opData,       // literal text
+        opTitle,      // <%title%>
+        opUrl,        // <%url%>
+        opNamespace,  // <%namespace%>
+        opContent,    // <%content%>
+        opToken,      // unknown token; the range holds its name
+        opLink        // <%/ns/url%>; the range holds the url
+      };
+
+      struct Op
+      {
+        OpType type;
+        std::string::size_type offset;
+        std::string::size_type size;
+        char ns;
+      };
+
+      typedef std::vector<Op> Ops;
+
+    private:
+      std::string text;
+      Ops ops;
+
+      class Compiler;
+      friend class Compiler;
+
+    public:
+      CompiledTemplate(const char* data, unsigned size);
+
+      const Ops& getOps() const             { return ops; }
+      const char* getText(const Op& op) const  { return text.data() + op.offset; }
+  };
+
 }
 
 #endif // ZIM_TEMPLATE_H
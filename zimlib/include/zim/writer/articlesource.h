@@ -25,6 +25,7 @@
 #include <zim/zim.h>
 #include <zim/fileheader.h>
 #include <string>
+#include <vector>
 
 namespace zim
 {
@@ -34,6 +35,8 @@ namespace zim
     class Article
     {
       public:
+        virtual ~Article() { }
+
         virtual std::string getAid() const = 0;
         virtual char getNamespace() const = 0;
         virtual std::string getUrl() const = 0;
@@ -48,6 +51,18 @@ namespace zim
         virtual std::string getParameter() const;
         virtual Blob getData() const = 0;
 
+        // Returns the name of a file, which holds the data of the article,
+        // or an empty string. When a file is given, getData is not called.
+        // Large files are copied in chunks into the zim file, so that they
+        // are never held in memory completely.
+        virtual std::string getDataPath() const;
+
+        // Returns the urls of the articles referenced by this article with
+        // their namespace (e.g. "I/logo.png"). The links are used to place
+        // articles, which are viewed together, into the same cluster. When
+        // no links are returned, they are extracted from html content.
+        virtual std::vector<std::string> getLinks() const;
+
         // returns the next category id, to which the article is assigned to
         virtual std::string getNextCategory();
     };
@@ -63,6 +78,8 @@ namespace zim
     class ArticleSource
     {
       public:
+        virtual ~ArticleSource() { }
+
         virtual void setFilename(const std::string& fname) { }
         virtual const Article* getNextArticle() = 0;
         virtual Uuid getUuid();
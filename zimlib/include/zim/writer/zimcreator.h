@@ -24,11 +24,18 @@
 #include <zim/writer/dirent.h>
 #include <vector>
 #include <map>
+#include <pthread.h>
 
 namespace zim
 {
+  class Cluster;
+  class ClusterWriter;
+
   namespace writer
   {
+    class ArticleQueue;
+    class DirentSpill;
+
     class ZimCreator
     {
       public:
@@ -41,6 +48,7 @@ namespace zim
 
       private:
         unsigned minChunkSize;
+        unsigned compressThreads;
 
         Fileheader header;
 
@@ -53,26 +61,94 @@ namespace zim
         CompressionType compression;
         bool isEmpty;
         offset_type clustersSize;
+        bool classicLayout;
+        bool clusterChecksums;
+        bool directoryFirst;         // layout of the file being created
+        offset_type tmpClustersPos;  // start of the clusters in the temporary file
+
+        // Space reserved for the header and the mime type list, when the
+        // clusters are written directly into the zim file.
+        static const offset_type reservedSize = 65536;
+
         offset_type currentSize;
 
-        void createDirentsAndClusters(ArticleSource& src, const std::string& tmpfname);
+        // Directory entries are written to temporary files, when they need
+        // more than maxDirentMemory bytes (0 means no limit).
+        offset_type maxDirentMemory;
+        offset_type direntMemory;
+        DirentSpill* direntSpill;
+
+        // Identical blobs are stored only once. The table of blob hashes
+        // uses at most dedupMemory bytes (0, the default, disables
+        // deduplication). Blobs are identified by MD5 sum and size; the
+        // data is compared only while the first blob is in an open cluster.
+        // Since MD5 collisions can be constructed, enable it only for
+        // trusted content.
+        offset_type dedupMemory;
+
+        // Compressed blobs are grouped into clusters by mime type and, when
+        // similarityBuckets is set, by a MinHash of their content. Up to
+        // clusterGroups compressed clusters are filled at the same time.
+        struct OpenCluster;
+        typedef std::vector<OpenCluster> OpenClusters;
+        unsigned clusterGroups;
+        unsigned similarityBuckets;
+        bool localityPlacement;
+        unsigned largeBlobSize;
+        unsigned minSaving;
+        unsigned fastCodecTolerance;
+        std::vector<size_type> clusterNumbers;  // by serial of the cluster
+        size_type nextSerial;
+        size_type useCounter;
+
+        // state of the push interface
+        ArticleQueue* articleQueue;
+        pthread_t creatorThread;
+        std::string creatorFilename;
+        std::string creatorError;
+        std::string mainPage;
+        std::string layoutPage;
+        unsigned maxQueuedArticles;
+        offset_type maxQueuedBytes;
+
+        static void* creatorThreadStart(void* arg);
+        void runCreator();
+
+        void createDirentsAndClusters(ArticleSource& src, const std::string& fname, const std::string& tmpfname);
+        size_type closeCluster(ClusterWriter& clusterWriter, Cluster& cluster, DirentPtrsType& clusterDirents);
+        void closeOpenCluster(ClusterWriter& clusterWriter, OpenCluster& open);
+        OpenCluster& getOpenCluster(ClusterWriter& clusterWriter, OpenClusters& openClusters, uint32_t group);
+        uint32_t clusterGroup(const Dirent& dirent, const Blob& blob) const;
+        void addChecksumTable(ClusterWriter& clusterWriter);
+        void spillDirents(const std::string& tmpfname, OpenClusters& openClusters);
         void createTitleIndex(ArticleSource& src);
         void fillHeader(ArticleSource& src);
+        void setHeaderPositions();
         void write(const std::string& fname, const std::string& tmpfname);
+        void writeClassic(const std::string& fname, const std::string& tmpfname,
+                          const std::vector<std::string>& mimeList,
+                          const std::vector<uint16_t>& mapping);
+        void writeDirect(const std::string& fname,
+                         const std::vector<std::string>& mimeList,
+                         const std::vector<uint16_t>& mapping);
+        void writeDirectory(std::ostream& out, const std::vector<uint16_t>& mimeMapping);
+        void writeChecksum(const std::string& fname);
 
         size_type clusterCount() const        { return clusterOffsets.size(); }
-        size_type articleCount() const        { return dirents.size(); }
+        unsigned sortThreads() const          { return compressThreads > 0 ? compressThreads : 1; }
+        size_type articleCount() const;
         offset_type mimeListSize() const;
         offset_type mimeListPos() const       { return Fileheader::size; }
         offset_type urlPtrSize() const        { return articleCount() * sizeof(offset_type); }
-        offset_type urlPtrPos() const         { return mimeListPos() + mimeListSize(); }
+        offset_type urlPtrPos() const         { return directoryFirst ? mimeListPos() + mimeListSize() : clustersPos() + clustersSize; }
         offset_type titleIdxSize() const      { return articleCount() * sizeof(size_type); }
         offset_type titleIdxPos() const       { return urlPtrPos() + urlPtrSize(); }
         offset_type indexSize() const;
         offset_type indexPos() const          { return titleIdxPos() + titleIdxSize(); }
         offset_type clusterPtrSize() const    { return clusterCount() * sizeof(offset_type); }
         offset_type clusterPtrPos() const     { return indexPos() + indexSize(); }
-        offset_type checksumPos() const       { return clusterPtrPos() + clusterPtrSize() + clustersSize; }
+        offset_type clustersPos() const       { return directoryFirst ? clusterPtrPos() + clusterPtrSize() : reservedSize; }
+        offset_type checksumPos() const       { return directoryFirst ? clustersPos() + clustersSize : clusterPtrPos() + clusterPtrSize(); }
 
         uint16_t getMimeTypeIdx(const std::string& mimeType);
         const std::string& getMimeType(uint16_t mimeTypeIdx) const;
@@ -80,12 +156,98 @@ namespace zim
       public:
         ZimCreator();
         ZimCreator(int& argc, char* argv[]);
+        ~ZimCreator();
 
         unsigned getMinChunkSize()    { return minChunkSize; }
         void setMinChunkSize(int s)   { minChunkSize = s; }
 
+        // Clusters are compressed by this number of threads while the next
+        // articles are fetched. The directory entries are sorted with the
+        // same number of threads. The default is the number of processors.
+        // With 0 clusters are compressed by the calling thread.
+        unsigned getCompressThreads() const   { return compressThreads; }
+        void setCompressThreads(unsigned n)   { compressThreads = n; }
+
+        // Limits the memory used for directory entries. When the entries
+        // need more, they are sorted in temporary files next to the output
+        // file, so that very large files can be created with modest memory.
+        // 0 keeps all entries in memory, which is the default.
+        offset_type getMaxDirentMemory() const      { return maxDirentMemory; }
+        void setMaxDirentMemory(offset_type bytes)  { maxDirentMemory = bytes; }
+
+        offset_type getDedupMemory() const          { return dedupMemory; }
+        void setDedupMemory(offset_type bytes)      { dedupMemory = bytes; }
+
+        // Number of compressed clusters filled at the same time; 1, the
+        // default, puts the compressed blobs into clusters in the order of
+        // the articles.
+        unsigned getClusterGroups() const           { return clusterGroups; }
+        void setClusterGroups(unsigned n)           { clusterGroups = n > 0 ? n : 1; }
+
+        // Number of groups of similar content per mime type (0 disables the
+        // similarity grouping).
+        unsigned getSimilarityBuckets() const       { return similarityBuckets; }
+        void setSimilarityBuckets(unsigned n)       { similarityBuckets = n; }
+
+        // Reorders the articles within a window using their links, so that
+        // html pages and the small assets they reference are stored in the
+        // same cluster. Replaces the grouping of compressed blobs.
+        bool getLocalityPlacement() const           { return localityPlacement; }
+        void setLocalityPlacement(bool sw)          { localityPlacement = sw; }
+
+        // Blobs of at least this size in kB are stored in a cluster of their
+        // own; uncompressed, when the article should not be compressed. 0,
+        // the default, disables the isolation of large blobs. The data of
+        // such blobs is copied from Article::getDataPath in chunks. Files,
+        // which are at least as large as a cluster, are always copied in
+        // chunks into a cluster of their own; smaller files are read into
+        // memory.
+        unsigned getLargeBlobSize() const           { return largeBlobSize; }
+        void setLargeBlobSize(unsigned kB)          { largeBlobSize = kB; }
+
+        // Adaptive compression chooses the codec for each cluster; both
+        // settings are disabled by 0.
+        // Compressed clusters, which get less than percent smaller, are
+        // stored uncompressed.
+        unsigned getMinSaving() const               { return minSaving; }
+        void setMinSaving(unsigned percent)         { minSaving = percent; }
+
+        // Clusters are compressed with zlib, which decompresses faster, when
+        // the result is at most percent larger than with the chosen codec.
+        unsigned getFastCodecTolerance() const      { return fastCodecTolerance; }
+        void setFastCodecTolerance(unsigned percent)  { fastCodecTolerance = percent; }
+
+        // By default the clusters are written directly into the zim file
+        // behind the space reserved for the header and the mime type list,
+        // and the directory follows the clusters. The classic layout puts
+        // the directory before the clusters; the clusters are collected in
+        // a temporary file and copied into the zim file then.
+        bool getClassicLayout() const       { return classicLayout; }
+        void setClassicLayout(bool sw)      { classicLayout = sw; }
+
+        // Adds a table with a CRC32C of each cluster, so that readers can
+        // check clusters independently and in parallel.
+        bool getClusterChecksums() const    { return clusterChecksums; }
+        void setClusterChecksums(bool sw)   { clusterChecksums = sw; }
+
         void create(const std::string& fname, ArticleSource& src);
 
+        /* Push interface: instead of pulling the articles from an
+         * ArticleSource the articles are passed to addArticle, which may
+         * be called from many threads at the same time. The articles are
+         * copied into a bounded queue and processed by a creator thread,
+         * which is started by startZimCreation. finishZimCreation waits
+         * until the file is written and throws an exception, when the
+         * creation has failed. */
+        void setMainPage(const std::string& aid)     { mainPage = aid; }
+        void setLayoutPage(const std::string& aid)   { layoutPage = aid; }
+        void setMaxQueueSize(unsigned articles, offset_type bytes)
+          { maxQueuedArticles = articles; maxQueuedBytes = bytes; }
+
+        void startZimCreation(const std::string& fname);
+        void addArticle(const Article& article);
+        void finishZimCreation();
+
         /* The user can query `currentSize` after each article has been
          * added to the ZIM file. */
         offset_type getCurrentSize() { return currentSize; }
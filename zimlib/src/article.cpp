@@ -19,7 +19,6 @@
 
 #include <zim/article.h>
 #include <zim/template.h>
-#include <sstream>
 #include <iostream>
 #include <stdexcept>
 #include "log.h"
@@ -35,105 +34,163 @@ namespace zim
                .getBlobSize(dirent.getBlobNumber());
   }
 
+  Blob Article::getDataRange(offset_type offset, size_type length) const
+  {
+    Dirent dirent = getDirent();
+    if (dirent.isRedirect() || dirent.isLinktarget() || dirent.isDeleted())
+      return Blob();
+
+    return file.getCluster(dirent.getClusterNumber())
+               .getBlob(dirent.getBlobNumber(), offset, length);
+  }
+
   namespace
   {
-    class Ev : public TemplateParser::Event
+    // Output targets of renderPage. Writing to a string directly avoids
+    // the copy through an ostringstream.
+    class StreamSink
     {
         std::ostream& out;
-        Article& article;
-        unsigned maxRecurse;
 
       public:
-        Ev(std::ostream& out_, Article& article_, unsigned maxRecurse_)
-          : out(out_),
-            article(article_),
-            maxRecurse(maxRecurse_)
+        explicit StreamSink(std::ostream& out_)
+          : out(out_)
           { }
-        void onData(const std::string& data);
-        void onToken(const std::string& token);
-        void onLink(char ns, const std::string& title);
+
+        void write(const char* data, std::string::size_type size)
+          { out.write(data, size); }
+        void write(const std::string& s)
+          { out << s; }
+        void write(char ch)
+          { out << ch; }
+        void writePage(Article& article, unsigned maxRecurse)
+          { article.getPage(out, false, maxRecurse); }
     };
 
-    void Ev::onData(const std::string& data)
+    class StringSink
     {
-      out << data;
+        std::string& out;
+
+      public:
+        explicit StringSink(std::string& out_)
+          : out(out_)
+          { }
+
+        void write(const char* data, std::string::size_type size)
+          { out.append(data, size); }
+        void write(const std::string& s)
+          { out += s; }
+        void write(char ch)
+          { out += ch; }
+        void writePage(Article& article, unsigned maxRecurse);
+    };
+
+    template <typename Sink>
+    void renderPage(Sink& sink, Article& article, bool layout, unsigned maxRecurse);
+
+    void StringSink::writePage(Article& article, unsigned maxRecurse)
+    {
+      renderPage(*this, article, false, maxRecurse);
     }
 
-    void Ev::onToken(const std::string& token)
+    template <typename Sink>
+    void renderTemplate(Sink& sink, const CompiledTemplate& tmpl, Article& article, unsigned maxRecurse)
     {
-      log_trace("onToken(\"" << token << "\")");
-
-      if (token == "title")
-        out << article.getTitle();
-      else if (token == "url")
-        out << article.getUrl();
-      else if (token == "namespace")
-        out << article.getNamespace();
-      else if (token == "content")
-      {
-        if (maxRecurse <= 0)
-          throw std::runtime_error("maximum recursive limit is reached");
-        article.getPage(out, false, maxRecurse - 1);
-      }
-      else
+      const CompiledTemplate::Ops& ops = tmpl.getOps();
+      for (CompiledTemplate::Ops::const_iterator it = ops.begin(); it != ops.end(); ++it)
       {
-        log_warn("unknown token \"" << token  << "\" found in template");
-        out << "<%" << token << "%>";
+        switch (it->type)
+        {
+          case CompiledTemplate::opData:
+            sink.write(tmpl.getText(*it), it->size);
+            break;
+
+          case CompiledTemplate::opTitle:
+            sink.write(article.getTitle());
+            break;
+
+          case CompiledTemplate::opUrl:
+            sink.write(article.getUrl());
+            break;
+
+          case CompiledTemplate::opNamespace:
+            sink.write(article.getNamespace());
+            break;
+
+          case CompiledTemplate::opContent:
+            if (maxRecurse <= 0)
+              throw std::runtime_error("maximum recursive limit is reached");
+            sink.writePage(article, maxRecurse - 1);
+            break;
+
+          case CompiledTemplate::opToken:
+            log_warn("unknown token \"" << std::string(tmpl.getText(*it), it->size) << "\" found in template");
+            sink.write("<%", 2);
+            sink.write(tmpl.getText(*it), it->size);
+            sink.write("%>", 2);
+            break;
+
+          case CompiledTemplate::opLink:
+          {
+            if (maxRecurse <= 0)
+              throw std::runtime_error("maximum recursive limit is reached");
+            Article linked = article.getFile().getArticle(it->ns, std::string(tmpl.getText(*it), it->size));
+            sink.writePage(linked, maxRecurse - 1);
+            break;
+          }
+        }
       }
     }
 
-    void Ev::onLink(char ns, const std::string& url)
+    template <typename Sink>
+    void renderPage(Sink& sink, Article& article, bool layout, unsigned maxRecurse)
     {
-      if (maxRecurse <= 0)
-        throw std::runtime_error("maximum recursive limit is reached");
-      article.getFile().getArticle(ns, url).getPage(out, false, maxRecurse - 1);
+      log_trace("renderPage(" << layout << ", " << maxRecurse << ')');
+
+      const std::string& mimeType = article.getMimeType();
+      if (mimeType.compare(0, 9, "text/html") == 0 || mimeType == MimeHtmlTemplate)
+      {
+        if (layout)
+        {
+          // the layout page is compiled once per file
+          SmartPtr<CompiledTemplate> tmpl = article.getFile().getLayoutTemplate();
+          if (tmpl)
+          {
+            renderTemplate(sink, *tmpl, article, maxRecurse);
+            return;
+          }
+        }
+
+        if (mimeType == MimeHtmlTemplate)
+        {
+          Blob data = article.getData();
+          CompiledTemplate tmpl(data.data(), data.size());
+          renderTemplate(sink, tmpl, article, maxRecurse);
+          return;
+        }
+      }
+
+      // default case - template cases has return above
+      Blob data = article.getData();
+      if (data.data())
+        sink.write(data.data(), data.size());
     }
 
   }
 
   std::string Article::getPage(bool layout, unsigned maxRecurse)
   {
-    std::ostringstream s;
-    getPage(s, layout, maxRecurse);
-    return s.str();
+    std::string ret;
+    StringSink sink(ret);
+    renderPage(sink, *this, layout, maxRecurse);
+    return ret;
   }
 
   void Article::getPage(std::ostream& out, bool layout, unsigned maxRecurse)
   {
-    log_trace("Article::getPage(" << layout << ", " << maxRecurse << ')');
-
-    if (getMimeType().compare(0, 9, "text/html") == 0 || getMimeType() == MimeHtmlTemplate)
-    {
-      if (layout && file.getFileheader().hasLayoutPage())
-      {
-        Article layoutPage = file.getArticle(file.getFileheader().getLayoutPage());
-        Blob data = layoutPage.getData();
-
-        Ev ev(out, *this, maxRecurse);
-        log_debug("call template parser");
-        TemplateParser parser(&ev);
-        for (const char* p = data.data(); p != data.end(); ++p)
-          parser.parse(*p);
-        parser.flush();
-
-        return;
-      }
-      else if (getMimeType() == MimeHtmlTemplate)
-      {
-        Blob data = getData();
-
-        Ev ev(out, *this, maxRecurse);
-        TemplateParser parser(&ev);
-        for (const char* p = data.data(); p != data.end(); ++p)
-          parser.parse(*p);
-        parser.flush();
-
-        return;
-      }
-    }
-
-    // default case - template cases has return above
-    out << getData();
+    StreamSink sink(out);
+    renderPage(sink, *this, layout, maxRecurse);
   }
 
 }
+
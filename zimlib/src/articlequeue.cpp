@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "articlequeue.h"
+#include <zim/blob.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include "log.h"
+
+log_define("zim.writer.queue")
+
+namespace zim
+{
+  namespace writer
+  {
+    QueuedArticle::QueuedArticle(const Article& article)
+      : aid(article.getAid()),
+        ns(article.getNamespace()),
+        url(article.getUrl()),
+        title(article.getTitle()),
+        version(article.getVersion()),
+        redirect(article.isRedirect()),
+        linktarget(article.isLinktarget()),
+        deleted(article.isDeleted()),
+        compress(false),
+        dataSize(0)
+    {
+      parameter = article.getParameter();
+
+      if (redirect)
+        redirectAid = article.getRedirectAid();
+      else if (!linktarget && !deleted)
+      {
+        mimeType = article.getMimeType();
+        compress = article.shouldCompress();
+        dataPath = article.getDataPath();
+        if (dataPath.empty())
+        {
+          Blob blob = article.getData();
+          data.assign(blob.data(), blob.size());
+          dataSize = data.size();
+        }
+        else
+        {
+          // a missing file is reported, when it is read
+          struct stat st;
+          if (::stat(dataPath.c_str(), &st) == 0)
+            dataSize = st.st_size;
+        }
+        links = article.getLinks();
+      }
+    }
+
+    ArticleQueue::ArticleQueue(unsigned maxArticles_, offset_type maxBytes_,
+                               const std::string& mainPage_, const std::string& layoutPage_)
+      : current(0),
+        maxArticles(maxArticles_ > 0 ? maxArticles_ : 1),
+        maxBytes(maxBytes_),
+        bytes(0),
+        closed(false),
+        mainPage(mainPage_),
+        layoutPage(layoutPage_)
+    {
+    }
+
+    ArticleQueue::~ArticleQueue()
+    {
+      delete current;
+      for (Articles::iterator it = articles.begin(); it != articles.end(); ++it)
+        delete *it;
+    }
+
+    void ArticleQueue::push(const Article& article)
+    {
+      // copy the article before locking, so that producers work in parallel
+      QueuedArticle* a = new QueuedArticle(article);
+
+      MutexLock lock(mutex);
+
+      // a single article larger than the limit is accepted, when the
+      // queue is empty
+      while (error.empty() && !closed && !articles.empty()
+        && (articles.size() >= maxArticles || bytes + a->getMemorySize() > maxBytes))
+        spaceAvailable.wait(mutex);
+
+      if (!error.empty() || closed)
+      {
+        delete a;
+        throw std::runtime_error(error.empty() ? "article added after zim creation has finished" : error);
+      }
+
+      articles.push_back(a);
+      bytes += a->getMemorySize();
+      articleAvailable.signal();
+    }
+
+    void ArticleQueue::close()
+    {
+      MutexLock lock(mutex);
+      closed = true;
+      articleAvailable.broadcast();
+      spaceAvailable.broadcast();
+    }
+
+    void ArticleQueue::setError(const std::string& msg)
+    {
+      MutexLock lock(mutex);
+      error = msg;
+      spaceAvailable.broadcast();
+    }
+
+    const Article* ArticleQueue::getNextArticle()
+    {
+      MutexLock lock(mutex);
+
+      // the previous article is not used by the creator any more
+      delete current;
+      current = 0;
+
+      while (articles.empty() && !closed)
+        articleAvailable.wait(mutex);
+
+      if (articles.empty())
+      {
+        log_debug("article queue closed");
+        return 0;
+      }
+
+      current = articles.front();
+      articles.pop_front();
+      bytes -= current->getMemorySize();
+      spaceAvailable.broadcast();
+
+      return current;
+    }
+
+  }
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_WRITER_ARTICLEQUEUE_H
+#define ZIM_WRITER_ARTICLEQUEUE_H
+
+#include <zim/writer/articlesource.h>
+#include <zim/mutex.h>
+#include <zim/noncopyable.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace zim
+{
+  namespace writer
+  {
+    // Copy of an article, which is passed from a producer thread to the
+    // creator.
+    class QueuedArticle : public Article
+    {
+        std::string aid;
+        char ns;
+        std::string url;
+        std::string title;
+        size_type version;
+        bool redirect;
+        bool linktarget;
+        bool deleted;
+        std::string mimeType;
+        bool compress;
+        std::string redirectAid;
+        std::string parameter;
+        std::string data;
+        std::string dataPath;
+        offset_type dataSize;
+        std::vector<std::string> links;
+
+      public:
+        explicit QueuedArticle(const Article& article);
+
+        virtual std::string getAid() const        { return aid; }
+        virtual char getNamespace() const         { return ns; }
+        virtual std::string getUrl() const        { return url; }
+        virtual std::string getTitle() const      { return title; }
+        virtual size_type getVersion() const      { return version; }
+        virtual bool isRedirect() const           { return redirect; }
+        virtual bool isLinktarget() const         { return linktarget; }
+        virtual bool isDeleted() const            { return deleted; }
+        virtual std::string getMimeType() const   { return mimeType; }
+        virtual bool shouldCompress() const       { return compress; }
+        virtual std::string getRedirectAid() const  { return redirectAid; }
+        virtual std::string getParameter() const  { return parameter; }
+        virtual Blob getData() const              { return Blob(data.data(), data.size()); }
+        virtual std::string getDataPath() const   { return dataPath; }
+        virtual std::vector<std::string> getLinks() const  { return links; }
+
+        // size of the data, also when it is read from getDataPath
+        offset_type getDataSize() const             { return dataSize; }
+        // size of the data held in memory
+        std::string::size_type getMemorySize() const  { return data.size(); }
+    };
+
+    /**
+     Article source, which is fed by other threads.
+
+     The queue is bounded by the number of articles and the size of their
+     data, so that producers block, when the creator falls behind.
+     */
+    class ArticleQueue : public ArticleSource, private NonCopyable
+    {
+        typedef std::deque<QueuedArticle*> Articles;
+
+        Mutex mutex;
+        Condition articleAvailable;
+        Condition spaceAvailable;
+        Articles articles;
+        QueuedArticle* current;
+        unsigned maxArticles;
+        offset_type maxBytes;
+        offset_type bytes;
+        bool closed;
+        std::string error;
+
+        std::string mainPage;
+        std::string layoutPage;
+
+      public:
+        ArticleQueue(unsigned maxArticles, offset_type maxBytes,
+                     const std::string& mainPage, const std::string& layoutPage);
+        ~ArticleQueue();
+
+        // Copies the article into the queue. Blocks while the queue is full.
+        // Throws an exception, when the creator has failed.
+        void push(const Article& article);
+
+        // Signals, that no more articles follow.
+        void close();
+
+        // Stops the producers after the creator has failed.
+        void setError(const std::string& msg);
+
+        virtual const Article* getNextArticle();
+        virtual std::string getMainPage()     { return mainPage; }
+        virtual std::string getLayoutPage()   { return layoutPage; }
+    };
+
+  }
+}
+
+#endif // ZIM_WRITER_ARTICLEQUEUE_H
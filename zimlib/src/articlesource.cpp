@@ -64,6 +64,16 @@ namespace zim
       return std::string();
     }
 
+    std::string Article::getDataPath() const
+    {
+      return std::string();
+    }
+
+    std::vector<std::string> Article::getLinks() const
+    {
+      return std::vector<std::string>();
+    }
+
     std::string Article::getNextCategory()
     {
       return std::string();
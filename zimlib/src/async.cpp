@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <zim/async.h>
+#include <zim/file.h>
+#include <zim/article.h>
+#include <zim/error.h>
+#include <stdexcept>
+#include "executor.h"
+#include "log.h"
+
+log_define("zim.async")
+
+namespace zim
+{
+  namespace
+  {
+    class ArticleJob : public AsyncJob
+    {
+        File file;
+        char ns;
+        std::string url;
+        ArticleEvent& event;
+
+        Article article;
+        Blob data;
+        std::string error;
+        bool failed;
+
+      protected:
+        void execute();
+        void deliver();
+
+      public:
+        ArticleJob(const File& file_, char ns_, const std::string& url_, ArticleEvent& event_)
+          : file(file_),
+            ns(ns_),
+            url(url_),
+            event(event_),
+            failed(false)
+          { }
+    };
+
+    void ArticleJob::execute()
+    {
+      try
+      {
+        article = file.getArticle(ns, url);
+        if (article.good())
+          data = article.getData();
+      }
+      catch (const std::exception& e)
+      {
+        failed = true;
+        error = e.what();
+      }
+    }
+
+    void ArticleJob::deliver()
+    {
+      if (failed)
+        event.onError(std::runtime_error(error));
+      else
+        event.onArticle(article, data);
+    }
+
+    class BlobJob : public AsyncJob
+    {
+        File file;
+        size_type clusterIdx;
+        size_type blobIdx;
+        BlobEvent& event;
+
+        Blob blob;
+        std::string error;
+        bool failed;
+
+      protected:
+        void execute();
+        void deliver();
+
+      public:
+        BlobJob(const File& file_, size_type clusterIdx_, size_type blobIdx_, BlobEvent& event_)
+          : file(file_),
+            clusterIdx(clusterIdx_),
+            blobIdx(blobIdx_),
+            event(event_),
+            failed(false)
+          { }
+    };
+
+    void BlobJob::execute()
+    {
+      try
+      {
+        if (clusterIdx >= file.getCountClusters())
+          throw ZimFileFormatError("cluster index out of range");
+
+        Cluster cluster = file.getCluster(clusterIdx);
+        if (blobIdx >= cluster.count())
+          throw ZimFileFormatError("blob index out of range");
+
+        blob = cluster.getBlob(blobIdx);
+      }
+      catch (const std::exception& e)
+      {
+        failed = true;
+        error = e.what();
+      }
+    }
+
+    void BlobJob::deliver()
+    {
+      if (failed)
+        event.onError(std::runtime_error(error));
+      else
+        event.onBlob(blob);
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  // AsyncJob
+  //
+  void AsyncJob::run()
+  {
+    MutexLock lock(mutex);
+    if (state != statePending)
+      return;
+    state = stateRunning;
+    lock.unlock();
+
+    execute();
+
+    lock.lock();
+    if (state == stateCancelled)
+    {
+      log_debug("job cancelled while running");
+      return;
+    }
+    state = stateDelivering;
+    lock.unlock();
+
+    try
+    {
+      deliver();
+    }
+    catch (const std::exception& e)
+    {
+      log_error("exception in event receiver: " << e.what());
+    }
+
+    lock.lock();
+    state = stateDone;
+    finished.broadcast();
+  }
+
+  bool AsyncJob::cancel()
+  {
+    MutexLock lock(mutex);
+    if (state != statePending && state != stateRunning)
+      return false;
+
+    state = stateCancelled;
+    finished.broadcast();
+    return true;
+  }
+
+  void AsyncJob::wait()
+  {
+    MutexLock lock(mutex);
+    while (state < stateDone)
+      finished.wait(mutex);
+  }
+
+  AsyncJob::State AsyncJob::getState()
+  {
+    MutexLock lock(mutex);
+    return state;
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  // File
+  //
+  AsyncRequest File::getArticleAsync(char ns, const std::string& url, ArticleEvent& event)
+  {
+    log_trace("File::getArticleAsync('" << ns << "', \"" << url << "\")");
+    SmartPtr<AsyncJob> job = new ArticleJob(*this, ns, url, event);
+    Executor::getInstance().submit(job);
+    return AsyncRequest(job);
+  }
+
+  AsyncRequest File::getBlobAsync(size_type clusterIdx, size_type blobIdx, BlobEvent& event)
+  {
+    log_trace("File::getBlobAsync(" << clusterIdx << ", " << blobIdx << ')');
+    SmartPtr<AsyncJob> job = new BlobJob(*this, clusterIdx, blobIdx, event);
+    Executor::getInstance().submit(job);
+    return AsyncRequest(job);
+  }
+
+}
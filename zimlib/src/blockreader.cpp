@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "blockreader.h"
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+#include "log.h"
+
+log_define("zim.blockreader")
+
+namespace zim
+{
+  BlockReader::BlockReader(ifstream& file_, offset_type offset_, offset_type size, unsigned blockSize_)
+    : file(file_),
+      offset(offset_),
+      end(offset_ + size),
+      blockSize(blockSize_),
+      current(0),
+      started(false),
+      stop(false)
+  {
+    for (unsigned n = 0; n < 2; ++n)
+    {
+      blocks[n].data.resize(blockSize);
+      blocks[n].size = 0;
+      blocks[n].full = false;
+    }
+
+    int ret = ::pthread_create(&thread, 0, threadStart, this);
+    if (ret != 0)
+    {
+      std::ostringstream msg;
+      msg << "failed to create thread; error " << ret << " : " << strerror(ret);
+      throw std::runtime_error(msg.str());
+    }
+  }
+
+  BlockReader::~BlockReader()
+  {
+    MutexLock lock(mutex);
+    stop = true;
+    blockReleased.broadcast();
+    lock.unlock();
+
+    ::pthread_join(thread, 0);
+  }
+
+  void* BlockReader::threadStart(void* arg)
+  {
+    static_cast<BlockReader*>(arg)->readBlocks();
+    return 0;
+  }
+
+  void BlockReader::readBlocks()
+  {
+    unsigned idx = 0;
+    offset_type pos = offset;
+
+    try
+    {
+      while (true)
+      {
+        MutexLock lock(mutex);
+        while (blocks[idx].full && !stop)
+          blockReleased.wait(mutex);
+
+        if (stop)
+          return;
+
+        lock.unlock();
+
+        // an empty block marks the end of the range
+        Block& block = blocks[idx];
+        unsigned count = end - pos < blockSize ? end - pos : blockSize;
+        unsigned size = count > 0 ? file.readAt(&block.data[0], pos, count) : 0;
+        if (size < count)
+        {
+          std::ostringstream msg;
+          msg << "unexpected end of file at offset " << pos + size;
+          throw std::runtime_error(msg.str());
+        }
+
+        log_debug("block at offset " << pos << " with " << size << " bytes read");
+        pos += size;
+
+        lock.lock();
+        block.size = size;
+        block.full = true;
+        blockFilled.broadcast();
+
+        if (size == 0)
+          return;
+
+        idx ^= 1;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      MutexLock lock(mutex);
+      error = e.what();
+      blockFilled.broadcast();
+    }
+  }
+
+  const char* BlockReader::next(unsigned& count)
+  {
+    MutexLock lock(mutex);
+
+    // give the current block back to the reader
+    if (started)
+    {
+      if (blocks[current].full && blocks[current].size == 0)
+      {
+        count = 0;
+        return 0;
+      }
+
+      blocks[current].full = false;
+      blockReleased.broadcast();
+      current ^= 1;
+    }
+
+    started = true;
+
+    while (!blocks[current].full && error.empty())
+      blockFilled.wait(mutex);
+
+    if (!blocks[current].full)
+      throw std::runtime_error(error);
+
+    count = blocks[current].size;
+    return count > 0 ? &blocks[current].data[0] : 0;
+  }
+
+}
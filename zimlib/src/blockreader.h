@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_BLOCKREADER_H
+#define ZIM_BLOCKREADER_H
+
+#include <zim/zim.h>
+#include <zim/fstream.h>
+#include <zim/mutex.h>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace zim
+{
+  /**
+   Reads a range of a file sequentially in large blocks.
+
+   The blocks are read by a separate thread into two buffers, so that the
+   next block is read while the caller processes the current one.
+   */
+  class BlockReader
+  {
+      struct Block
+      {
+        std::vector<char> data;
+        unsigned size;
+        bool full;
+      };
+
+      ifstream& file;
+      offset_type offset;
+      offset_type end;
+      unsigned blockSize;
+
+      Mutex mutex;
+      Condition blockFilled;
+      Condition blockReleased;
+      Block blocks[2];
+      unsigned current;    // block returned by the last call to next
+      bool started;
+      bool stop;
+      std::string error;
+      pthread_t thread;
+
+      static void* threadStart(void* arg);
+      void readBlocks();
+
+      // no copy allowed
+      BlockReader(const BlockReader&);
+      BlockReader& operator=(const BlockReader&);
+
+    public:
+      BlockReader(ifstream& file, offset_type offset, offset_type size, unsigned blockSize = 4 * 1024 * 1024);
+      ~BlockReader();
+
+      // Returns the next block and its size in count or 0 at the end of the
+      // range. The data is valid until the next call. Throws an exception,
+      // when the file can't be read.
+      const char* next(unsigned& count);
+  };
+
+}
+
+#endif // ZIM_BLOCKREADER_H
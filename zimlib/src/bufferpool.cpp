@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <zim/bufferpool.h>
+#include <zim/mutex.h>
+#include <map>
+#include <vector>
+#include "config.h"
+#include "envvalue.h"
+#include "log.h"
+
+#ifdef HAVE_MADVISE
+#include <sys/mman.h>
+#endif
+
+log_define("zim.bufferpool")
+
+namespace zim
+{
+  namespace
+  {
+    // blocks smaller than this are not pooled
+    const std::size_t minPooledSize = 65536;
+
+    const std::size_t hugePageSize = 2 * 1024 * 1024;
+
+    // There are four size classes per power of two, so that at most 25% of
+    // a block are wasted.
+    std::size_t classSize(std::size_t size)
+    {
+      std::size_t p = minPooledSize;
+      while (p <= size / 2)
+        p *= 2;
+      std::size_t step = p / 4;
+      return (size + step - 1) / step * step;
+    }
+
+    class Pool
+    {
+        typedef std::map<std::size_t, std::vector<void*> > FreeBlocks;
+
+        Mutex mutex;
+        FreeBlocks freeBlocks;
+        std::size_t pooledBytes;
+        std::size_t maxPooledBytes;
+        bool hugePages;
+
+        bool useHugePages(std::size_t size) const
+          { return hugePages && size >= hugePageSize; }
+        void* allocateBlock(std::size_t size);
+        void releaseBlock(void* p, std::size_t size);
+
+      public:
+        Pool();
+
+        void* allocate(std::size_t size);
+        void deallocate(void* p, std::size_t size);
+    };
+
+    Pool::Pool()
+      : pooledBytes(0),
+        maxPooledBytes(envMemSize("ZIM_BUFFERPOOL", 32 * 1024 * 1024)),
+        hugePages(envValue("ZIM_HUGEPAGES", 0) != 0)
+    {
+#if !defined(HAVE_MADVISE) || !defined(MADV_HUGEPAGE)
+      if (hugePages)
+      {
+        log_warn("huge pages not supported");
+        hugePages = false;
+      }
+#endif
+      log_debug("buffer pool with max " << maxPooledBytes << " bytes; huge pages " << hugePages);
+    }
+
+    void* Pool::allocateBlock(std::size_t size)
+    {
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+      if (useHugePages(size))
+      {
+        // map more than needed, so that the block can be aligned to the
+        // huge page size
+        std::size_t mapSize = size + hugePageSize;
+        void* m = ::mmap(0, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED)
+          throw std::bad_alloc();
+
+        char* begin = static_cast<char*>(m);
+        char* p = begin + (hugePageSize - reinterpret_cast<std::size_t>(begin) % hugePageSize) % hugePageSize;
+        char* end = begin + mapSize;
+        if (p > begin)
+          ::munmap(begin, p - begin);
+        if (end > p + size)
+          ::munmap(p + size, end - (p + size));
+
+        ::madvise(p, size, MADV_HUGEPAGE);
+        return p;
+      }
+#endif
+      return ::operator new(size);
+    }
+
+    void Pool::releaseBlock(void* p, std::size_t size)
+    {
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+      if (useHugePages(size))
+      {
+        ::munmap(p, size);
+        return;
+      }
+#endif
+      ::operator delete(p);
+    }
+
+    void* Pool::allocate(std::size_t size)
+    {
+      std::size_t cls = classSize(size);
+
+      MutexLock lock(mutex);
+      FreeBlocks::iterator it = freeBlocks.find(cls);
+      if (it != freeBlocks.end() && !it->second.empty())
+      {
+        void* p = it->second.back();
+        it->second.pop_back();
+        pooledBytes -= cls;
+        log_debug("reuse block of " << cls << " bytes for " << size << " bytes");
+        return p;
+      }
+      lock.unlock();
+
+      log_debug("allocate block of " << cls << " bytes for " << size << " bytes");
+      return allocateBlock(cls);
+    }
+
+    void Pool::deallocate(void* p, std::size_t size)
+    {
+      std::size_t cls = classSize(size);
+
+      MutexLock lock(mutex);
+      if (pooledBytes + cls <= maxPooledBytes)
+      {
+        freeBlocks[cls].push_back(p);
+        pooledBytes += cls;
+        return;
+      }
+      lock.unlock();
+
+      log_debug("pool full; release block of " << cls << " bytes");
+      releaseBlock(p, cls);
+    }
+
+    Pool& getPool()
+    {
+      // The pool is never destroyed, since buffers may be released by
+      // static objects after it would be destroyed.
+      static Pool* pool = new Pool();
+      return *pool;
+    }
+  }
+
+  void* BufferPool::allocate(std::size_t size)
+  {
+    if (size < minPooledSize)
+      return ::operator new(size);
+    return getPool().allocate(size);
+  }
+
+  void BufferPool::deallocate(void* p, std::size_t size)
+  {
+    if (size < minPooledSize)
+      ::operator delete(p);
+    else
+      getPool().deallocate(p, size);
+  }
+
+}
@@ -21,10 +21,15 @@
 #include <zim/blob.h>
 #include <zim/endian.h>
 #include <zim/error.h>
+#include <zim/mutex.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <fstream>
 #include <sstream>
 
 #include "log.h"
+#include "envvalue.h"
+#include "ptrstream.h"
 
 #include "config.h"
 
@@ -49,6 +54,50 @@ log_define("zim.cluster")
 
 namespace zim
 {
+  namespace
+  {
+    size_type blobCopyThreshold = envValue("ZIM_BLOBCOPYSIZE", 0);
+
+#ifdef ENABLE_LZMA
+    /**
+     * read lzma preset from environment
+     * ZIM_LZMA_PRESET is a number followed optionally by a
+     * suffix 'e'. The number gives the preset and the suffix tells,
+     * if LZMA_PRESET_EXTREME should be set.
+     * e.g.:
+     *   ZIM_LZMA_LEVEL=9   => 9
+     *   ZIM_LZMA_LEVEL=3e  => 3 + extreme
+     */
+    uint32_t readLzmaPreset()
+    {
+      uint32_t lzmaPreset = 3 | LZMA_PRESET_EXTREME;
+      const char* e = ::getenv("ZIM_LZMA_LEVEL");
+      if (e)
+      {
+        char flag = '\0';
+        std::istringstream s(e);
+        s >> lzmaPreset >> flag;
+        if (flag == 'e')
+          lzmaPreset |= LZMA_PRESET_EXTREME;
+      }
+      return lzmaPreset;
+    }
+
+    // read once instead of for each cluster
+    const uint32_t lzmaPreset = readLzmaPreset();
+#endif
+  }
+
+  void Cluster::setBlobCopyThreshold(size_type size)
+  {
+    __atomic_store_n(&blobCopyThreshold, size, __ATOMIC_RELAXED);
+  }
+
+  size_type Cluster::getBlobCopyThreshold()
+  {
+    return __atomic_load_n(&blobCopyThreshold, __ATOMIC_RELAXED);
+  }
+
   Cluster::Cluster()
     : impl(0)
     { }
@@ -63,7 +112,8 @@ namespace zim
   ClusterImpl::ClusterImpl()
     : compression(zimcompNone),
       startOffset(0),
-      lazy_read_stream(NULL)
+      lazy_read_stream(NULL),
+      mappedData(0)
   {
     offsets.push_back(0);
   }
@@ -127,14 +177,26 @@ namespace zim
   }
 
   void ClusterImpl::finalise_read() {
+    // Blobs of the same cluster may be read from different threads, so
+    // the data is read exactly once. It is read using readAt, which does
+    // not touch the stream position used by the file.
+    MutexLock lock(lazyReadMutex);
     if ( !lazy_read_stream )
-    {
-        std::cerr << "lazy_read null" << std::endl;
         return;
+
+    _data.clear();
+    size_type n = offsets.back() - offsets.front();
+    if (n > 0)
+    {
+      _data.resize(n);
+      log_debug("read " << n << " bytes of data");
+      if (lazy_read_stream->readAt(&_data[0], startOffset, n) != n)
+        throw ZimFileFormatError("error reading cluster data");
     }
-    lazy_read_stream->seekg(startOffset);
-    read_content(*lazy_read_stream);
-    lazy_read_stream = NULL;
+    else
+      log_warn("read empty cluster");
+
+    __atomic_store_n(&lazy_read_stream, static_cast<ifstream*>(0), __ATOMIC_RELEASE);
   }
 
   void ClusterImpl::write(std::ostream& out) const
@@ -148,12 +210,35 @@ namespace zim
       out.write(reinterpret_cast<const char*>(&o), sizeof(size_type));
     }
 
-    if (_data.size() > 0)
+    if (!blobFile.empty())
+      writeBlobFile(out);
+    else if (_data.size() > 0)
       out.write(&(_data[0]), _data.size());
     else
       log_warn("write empty cluster");
   }
 
+  void ClusterImpl::writeBlobFile(std::ostream& out) const
+  {
+    log_debug("write data of file " << blobFile);
+
+    std::ifstream in(blobFile.c_str(), std::ios::in | std::ios::binary);
+    if (!in)
+      throw std::runtime_error("failed to open file " + blobFile);
+
+    std::vector<char> buffer(65536);
+    size_type remaining = offsets.back() - offsets.front();
+    while (remaining > 0)
+    {
+      size_type n = std::min(remaining, static_cast<size_type>(buffer.size()));
+      in.read(&buffer[0], n);
+      if (in.gcount() != static_cast<std::streamsize>(n))
+        throw std::runtime_error("file " + blobFile + " is shorter than expected");
+      out.write(&buffer[0], n);
+      remaining -= n;
+    }
+  }
+
   void ClusterImpl::addBlob(const Blob& blob)
   {
     log_debug1("addBlob(ptr, " << blob.size() << ')');
@@ -164,14 +249,54 @@ namespace zim
   Blob ClusterImpl::getBlob(size_type n) const
   {
     size_type s = getSize();
-    return s > 0 ? Blob(const_cast<ClusterImpl*>(this), getData(n), getSize(n))
-                 : Blob();
+    if (s == 0)
+      return Blob();
+
+    // Blobs of mapped clusters keep the mapping alive instead of the
+    // cluster.
+    if (mappedData)
+      return Blob(const_cast<RefCounted*>(mapping.getPointer()), getData(n), getSize(n));
+
+    // Small blobs are copied, so that a long living reference does not keep
+    // the whole cluster in memory.
+    size_type size = getSize(n);
+    if (size < Cluster::getBlobCopyThreshold() && size < data().size())
+    {
+      SmartPtr<BlobBuffer> buffer = new BlobBuffer(size);
+      std::copy(getData(n), getData(n) + size, buffer->data());
+      return Blob(buffer.getPointer(), buffer->data(), size);
+    }
+
+    return Blob(const_cast<ClusterImpl*>(this), getData(n), size);
+  }
+
+  Blob ClusterImpl::getBlob(size_type n, offset_type offset, size_type size) const
+  {
+    size_type blobSize = getSize(n);
+    if (offset >= blobSize)
+      return Blob();
+    if (size > blobSize - offset)
+      size = blobSize - offset;
+
+    ifstream* in = __atomic_load_n(&lazy_read_stream, __ATOMIC_ACQUIRE);
+    if (in == 0 || mappedData)
+      return Blob(getBlob(n), offset, size);
+
+    // read just the range instead of the whole cluster
+    log_debug("read " << size << " bytes at offset " << offset << " of blob " << n);
+    SmartPtr<BlobBuffer> buffer = new BlobBuffer(size);
+    if (size > 0 && in->readAt(buffer->data(), getOffset(n) + offset, size) != size)
+      throw ZimFileFormatError("error reading blob data");
+    return Blob(buffer.getPointer(), buffer->data(), size);
   }
 
   void ClusterImpl::clear()
   {
     offsets.clear();
     _data.clear();
+    blobFile.clear();
+    mapping = SmartPtr<RefCounted>();
+    mappedData = 0;
     offsets.push_back(0);
   }
 
@@ -180,11 +305,25 @@ namespace zim
     addBlob(Blob(data, size));
   }
 
+  void ClusterImpl::addBlobFile(const std::string& fname, size_type size)
+  {
+    if (getCount() > 0)
+      throw std::runtime_error("a blob file must be the only blob of a cluster");
+
+    blobFile = fname;
+    offsets.push_back(size);
+  }
+
   Blob Cluster::getBlob(size_type n) const
   {
     return impl->getBlob(n);
   }
 
+  Blob Cluster::getBlob(size_type n, offset_type offset, size_type size) const
+  {
+    return impl->getBlob(n, offset, size);
+  }
+
   void Cluster::init_from_stream(ifstream& in, offset_type offset)
   {
     getImpl()->init_from_stream(in, offset);
@@ -207,9 +346,28 @@ namespace zim
       case zimcompNone:
         startOffset = read_header(in);
         startOffset += sizeof(char) + offset;
-        set_lazy_read(&in);
+        mappedData = in.map(startOffset, offsets.back() - offsets.front(), mapping);
+        if (!mappedData)
+          set_lazy_read(&in);
         break;
 
+      case zimcompZip:
+      case zimcompBzip2:
+      case zimcompLzma:
+        read_compressed(in);
+        break;
+
+      default:
+        log_error("invalid compression flag " << c);
+        in.setstate(std::ios::failbit);
+        break;
+    }
+  }
+
+  void ClusterImpl::read_compressed(std::istream& in)
+  {
+    switch (compression)
+    {
       case zimcompZip:
         {
 #ifdef ENABLE_ZLIB
@@ -253,12 +411,52 @@ namespace zim
         }
 
       default:
-        log_error("invalid compression flag " << c);
-        in.setstate(std::ios::failbit);
         break;
     }
   }
 
+  void Cluster::init_from_buffer(const char* data, offset_type size)
+  {
+    getImpl()->init_from_buffer(data, size);
+  }
+
+  void ClusterImpl::init_from_buffer(const char* data, offset_type size)
+  {
+    log_trace("init_from_buffer");
+
+    clear();
+
+    if (size == 0)
+      throw ZimFileFormatError("empty cluster");
+
+    setCompression(static_cast<CompressionType>(data[0]));
+
+    ptrstream in(const_cast<char*>(data) + 1, const_cast<char*>(data) + size);
+    switch (compression)
+    {
+      case zimcompDefault:
+      case zimcompNone:
+        read_header(in);
+        read_content(in);
+        if (in.fail())
+          throw ZimFileFormatError("error reading cluster data");
+        break;
+
+      case zimcompZip:
+      case zimcompBzip2:
+      case zimcompLzma:
+        read_compressed(in);
+        break;
+
+      default:
+        {
+          std::ostringstream msg;
+          msg << "invalid compression flag " << static_cast<int>(data[0]);
+          throw ZimFileFormatError(msg.str());
+        }
+    }
+  }
+
   std::ostream& operator<< (std::ostream& out, const ClusterImpl& clusterImpl)
   {
     log_trace("write cluster");
@@ -279,7 +477,7 @@ namespace zim
           zim::DeflateStream os(out);
           os.exceptions(std::ios::failbit | std::ios::badbit);
           clusterImpl.write(os);
-          os.flush();
+          os.end();
 #else
           throw std::runtime_error("zlib not enabled in this library");
 #endif
@@ -303,26 +501,6 @@ namespace zim
       case zimcompLzma:
         {
 #ifdef ENABLE_LZMA
-          uint32_t lzmaPreset = 3 | LZMA_PRESET_EXTREME;
-          /**
-           * read lzma preset from environment
-           * ZIM_LZMA_PRESET is a number followed optionally by a
-           * suffix 'e'. The number gives the preset and the suffix tells,
-           * if LZMA_PRESET_EXTREME should be set.
-           * e.g.:
-           *   ZIM_LZMA_LEVEL=9   => 9
-           *   ZIM_LZMA_LEVEL=3e  => 3 + extreme
-           */
-          const char* e = ::getenv("ZIM_LZMA_LEVEL");
-          if (e)
-          {
-            char flag = '\0';
-            std::istringstream s(e);
-            s >> lzmaPreset >> flag;
-            if (flag == 'e')
-              lzmaPreset |= LZMA_PRESET_EXTREME;
-          }
-
           log_debug("compress data (lzma, " << std::hex << lzmaPreset << ")");
           zim::LzmaStream os(out, lzmaPreset);
           os.exceptions(std::ios::failbit | std::ios::badbit);
@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "clusterwriter.h"
+#include "crc32c.h"
+#include "log.h"
+#include "config.h"
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+
+log_define("zim.clusterwriter")
+
+namespace zim
+{
+  namespace
+  {
+    // codec, which is tried first in adaptive compression
+#ifdef ENABLE_ZLIB
+    const CompressionType fastCompression = zimcompZip;
+#else
+    const CompressionType fastCompression = zimcompNone;
+#endif
+
+    std::string serialize(Cluster& cluster, CompressionType compression)
+    {
+      cluster.setCompression(compression);
+      std::ostringstream data;
+      data << cluster;
+      return data.str();
+    }
+
+    // Passes the data to another stream buffer and counts the bytes and,
+    // when requested, the checksum.
+    class CountingStreamBuf : public std::streambuf
+    {
+        std::streambuf* sink;
+        offset_type count;
+        bool withChecksum;
+        uint32_t checksum;
+
+      protected:
+        std::streamsize xsputn(const char* s, std::streamsize n)
+        {
+          std::streamsize ret = sink->sputn(s, n);
+          if (ret > 0)
+          {
+            count += ret;
+            if (withChecksum)
+              checksum = crc32c(checksum, s, ret);
+          }
+          return ret;
+        }
+
+        int_type overflow(int_type c)
+        {
+          if (traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::not_eof(c);
+          char ch = traits_type::to_char_type(c);
+          return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+        }
+
+      public:
+        CountingStreamBuf(std::streambuf* sink_, bool withChecksum_)
+          : sink(sink_),
+            count(0),
+            withChecksum(withChecksum_),
+            checksum(0)
+          { }
+
+        offset_type getCount() const   { return count; }
+        uint32_t getChecksum() const   { return checksum; }
+    };
+
+    // Returns, by how many percent the data got smaller.
+    unsigned saving(std::string::size_type size, offset_type rawSize)
+    {
+      return size < rawSize ? (rawSize - size) * 100 / rawSize : 0;
+    }
+  }
+
+  ClusterWriter::ClusterWriter(std::ostream& out_, unsigned threadCount, unsigned maxPending_)
+    : out(out_),
+      nextJob(0),
+      maxPending(maxPending_ > 0 ? maxPending_ : 2 * threadCount),
+      writing(false),
+      stop(false),
+      withChecksums(false),
+      minSaving(0),
+      fastTolerance(0),
+      offset(out_.tellp()),
+      written(0),
+      clusterCount(0)
+  {
+    if (maxPending == 0)
+      maxPending = 1;
+
+    MutexLock lock(mutex);
+    for (unsigned n = 0; n < threadCount; ++n)
+    {
+      pthread_t thread;
+      int ret = ::pthread_create(&thread, 0, threadStart, this);
+      if (ret != 0)
+      {
+        if (threads.empty())
+        {
+          std::ostringstream msg;
+          msg << "failed to create thread; error " << ret << " : " << strerror(ret);
+          throw std::runtime_error(msg.str());
+        }
+
+        log_warn("failed to create thread; error " << ret << " : " << strerror(ret));
+        break;
+      }
+
+      threads.push_back(thread);
+    }
+
+    log_debug(threads.size() << " compression threads started; max " << maxPending << " pending clusters");
+  }
+
+  ClusterWriter::~ClusterWriter()
+  {
+    shutdown();
+
+    for (Jobs::iterator it = jobs.begin(); it != jobs.end(); ++it)
+      delete *it;
+  }
+
+  void ClusterWriter::shutdown()
+  {
+    MutexLock lock(mutex);
+    stop = true;
+    workAvailable.broadcast();
+    lock.unlock();
+
+    for (std::vector<pthread_t>::iterator it = threads.begin(); it != threads.end(); ++it)
+      ::pthread_join(*it, 0);
+    threads.clear();
+  }
+
+  size_type ClusterWriter::add(const Cluster& cluster)
+  {
+    MutexLock lock(mutex);
+
+    while (jobs.size() >= maxPending && error.empty())
+      jobWritten.wait(mutex);
+
+    if (!error.empty())
+      throw std::runtime_error(error);
+
+    jobs.push_back(new Job(cluster));
+    size_type ret = clusterCount++;
+
+    if (threads.empty())
+    {
+      // no compression threads - do the work here
+      Job* job = jobs[nextJob++];
+      lock.unlock();
+      compress(job);
+      lock.lock();
+      job->done = true;
+      writeJobs(lock);
+
+      if (!error.empty())
+        throw std::runtime_error(error);
+    }
+    else
+      workAvailable.signal();
+
+    return ret;
+  }
+
+  void ClusterWriter::flush()
+  {
+    MutexLock lock(mutex);
+    while (!jobs.empty() && error.empty())
+      jobWritten.wait(mutex);
+
+    if (!error.empty())
+      throw std::runtime_error(error);
+  }
+
+  void ClusterWriter::finish()
+  {
+    try
+    {
+      flush();
+    }
+    catch (...)
+    {
+      shutdown();
+      throw;
+    }
+
+    shutdown();
+
+    log_debug(offsets.size() << " clusters with " << written << " bytes written");
+  }
+
+  offset_type ClusterWriter::getWrittenSize()
+  {
+    MutexLock lock(mutex);
+    return written;
+  }
+
+  size_type ClusterWriter::getClusterCount()
+  {
+    MutexLock lock(mutex);
+    return clusterCount;
+  }
+
+  void* ClusterWriter::threadStart(void* arg)
+  {
+    static_cast<ClusterWriter*>(arg)->runJobs();
+    return 0;
+  }
+
+  void ClusterWriter::runJobs()
+  {
+    MutexLock lock(mutex);
+
+    while (true)
+    {
+      while (nextJob >= jobs.size() && !stop)
+        workAvailable.wait(mutex);
+
+      if (nextJob >= jobs.size())
+        break;
+
+      Job* job = jobs[nextJob++];
+
+      lock.unlock();
+      compress(job);
+      lock.lock();
+
+      job->done = true;
+      writeJobs(lock);
+    }
+  }
+
+  void ClusterWriter::compress(Job* job)
+  {
+    try
+    {
+      Cluster& cluster = job->cluster;
+      CompressionType compression = cluster.getCompression();
+
+      // written by writeStreamed
+      if (cluster.hasBlobFile())
+        return;
+
+      if (!cluster.isCompressed() || (minSaving == 0 && fastTolerance == 0))
+        job->data = serialize(cluster, compression);
+      else
+      {
+        // The fast codec is tried first. Its result tells, whether the
+        // cluster is worth compressing with the configured codec.
+        offset_type rawSize = 1 + cluster.size();
+        std::string fast;
+        if (fastCompression != zimcompNone && fastCompression != compression)
+          fast = serialize(cluster, fastCompression);
+
+        if (minSaving > 0 && !fast.empty() && saving(fast.size(), rawSize) * 2 < minSaving)
+        {
+          log_debug("cluster gets only " << saving(fast.size(), rawSize) << "% smaller with the fast codec; store uncompressed");
+          job->data = serialize(cluster, zimcompNone);
+        }
+        else
+        {
+          job->data = serialize(cluster, compression);
+
+          if (fastTolerance > 0 && !fast.empty()
+            && fast.size() * 100 <= job->data.size() * (100 + fastTolerance))
+          {
+            log_debug("fast codec used; " << fast.size() << " instead of " << job->data.size() << " bytes");
+            job->data.swap(fast);
+          }
+
+          if (minSaving > 0 && saving(job->data.size(), rawSize) < minSaving)
+          {
+            log_debug("cluster gets only " << saving(job->data.size(), rawSize) << "% smaller; store uncompressed");
+            job->data = serialize(cluster, zimcompNone);
+          }
+        }
+      }
+
+      if (withChecksums)
+        job->checksum = crc32c(0, job->data.data(), job->data.size());
+    }
+    catch (const std::exception& e)
+    {
+      job->error = e.what();
+    }
+
+    // release the uncompressed data as early as possible
+    job->cluster = Cluster();
+  }
+
+  // Writes a cluster with a blob file, so that the data of the file is read
+  // and compressed in chunks. Returns the number of bytes written.
+  offset_type ClusterWriter::writeStreamed(Job* job)
+  {
+    CountingStreamBuf counter(out.rdbuf(), withChecksums);
+    std::ostream os(&counter);
+    os.exceptions(std::ios::failbit | std::ios::badbit);
+    os << job->cluster;
+    os.flush();
+
+    job->checksum = counter.getChecksum();
+    return counter.getCount();
+  }
+
+  // Writes the finished jobs at the front of the queue. Only one thread
+  // writes at a time; the others just leave their result in the queue.
+  // A job stays in the queue until it is written, so that flush waits for
+  // it. The mutex is locked on entry and on return.
+  void ClusterWriter::writeJobs(MutexLock& lock)
+  {
+    if (writing)
+      return;
+
+    writing = true;
+
+    while (!jobs.empty() && jobs.front()->done)
+    {
+      Job* job = jobs.front();
+
+      if (job->error.empty() && error.empty())
+      {
+        lock.unlock();
+
+        offsets.push_back(offset);
+        offset_type size = job->data.size();
+        std::string writeError;
+        if (job->cluster.hasBlobFile())
+        {
+          try
+          {
+            size = writeStreamed(job);
+          }
+          catch (const std::exception& e)
+          {
+            writeError = e.what();
+          }
+        }
+        else
+          out.write(job->data.data(), job->data.size());
+
+        if (withChecksums)
+          checksums.push_back(job->checksum);
+        offset += size;
+        bool ok = !out.fail();
+
+        lock.lock();
+
+        written += size;
+        if (!writeError.empty())
+          error = writeError;
+        else if (!ok)
+          error = "failed to write cluster";
+
+        log_debug("cluster " << offsets.size() - 1 << " written; " << size << " bytes");
+      }
+      else if (error.empty())
+        error = job->error;
+
+      jobs.pop_front();
+      --nextJob;
+      delete job;
+      jobWritten.broadcast();
+    }
+
+    writing = false;
+  }
+
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_CLUSTERWRITER_H
+#define ZIM_CLUSTERWRITER_H
+
+#include <zim/zim.h>
+#include <zim/cluster.h>
+#include <zim/mutex.h>
+#include <zim/noncopyable.h>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace zim
+{
+  /**
+   Compresses clusters in a pool of threads and writes them to a stream.
+
+   Clusters are written in the order they are added. The number of clusters,
+   which are compressed or wait to be written, is limited, so that add
+   blocks, when the writer falls behind. With 0 threads clusters are
+   compressed and written by the caller.
+
+   Clusters with a blob file are not compressed in advance; their data
+   passes through the compressor directly into the output, when they are
+   written.
+   */
+  class ClusterWriter : private NonCopyable
+  {
+    public:
+      typedef std::vector<offset_type> OffsetsType;
+      typedef std::vector<uint32_t> ChecksumsType;
+
+    private:
+      struct Job
+      {
+        Cluster cluster;
+        std::string data;
+        std::string error;
+        uint32_t checksum;
+        bool done;
+
+        explicit Job(const Cluster& cluster_)
+          : cluster(cluster_),
+            checksum(0),
+            done(false)
+          { }
+      };
+
+      typedef std::deque<Job*> Jobs;
+
+      std::ostream& out;
+      Mutex mutex;
+      Condition workAvailable;
+      Condition jobWritten;
+      Jobs jobs;               // jobs not yet written in order of clusters
+      Jobs::size_type nextJob; // index of the first job not yet compressed
+      Jobs::size_type maxPending;
+      std::vector<pthread_t> threads;
+      bool writing;
+      bool stop;
+      bool withChecksums;
+      unsigned minSaving;
+      unsigned fastTolerance;
+      std::string error;
+
+      OffsetsType offsets;
+      ChecksumsType checksums;
+      offset_type offset;
+      offset_type written;
+      size_type clusterCount;
+
+      static void* threadStart(void* arg);
+      void runJobs();
+      void compress(Job* job);
+      offset_type writeStreamed(Job* job);
+      void writeJobs(MutexLock& lock);
+      void shutdown();
+
+    public:
+      // Clusters are written at the current position of out. When
+      // maxPending is 0, twice the number of threads is used.
+      ClusterWriter(std::ostream& out, unsigned threads, unsigned maxPending = 0);
+      ~ClusterWriter();
+
+      // Queues a cluster and returns its number. The cluster must not be
+      // modified afterwards.
+      size_type add(const Cluster& cluster);
+
+      // Calculates the CRC32C of each written cluster, when enabled. Must be
+      // set before the first cluster is added.
+      void setChecksums(bool sw)   { withChecksums = sw; }
+
+      // Compressed clusters, which get less than percent smaller, are
+      // stored uncompressed. A cluster, which does not even get half as
+      // much smaller with zlib, is not compressed with the slower codec at
+      // all. 0 disables the check.
+      void setMinSaving(unsigned percent)         { minSaving = percent; }
+
+      // Compressed clusters are compressed with zlib instead, when the
+      // result is at most percent larger than with the configured codec,
+      // since zlib decompresses much faster. 0 disables the comparison.
+      void setFastCodecTolerance(unsigned percent)  { fastTolerance = percent; }
+
+      // Waits until all clusters added so far are written. Throws an
+      // exception, when compressing or writing failed.
+      void flush();
+
+      // Like flush, but stops the threads; no more clusters can be added.
+      void finish();
+
+      // Returns the number of bytes written so far.
+      offset_type getWrittenSize();
+
+      // Returns the number of clusters added so far.
+      size_type getClusterCount();
+
+      // Returns the offsets of the written clusters. Valid after finish.
+      const OffsetsType& getOffsets() const   { return offsets; }
+
+      // Returns the checksums of the written clusters. Valid after flush.
+      const ChecksumsType& getChecksums() const   { return checksums; }
+  };
+
+}
+
+#endif // ZIM_CLUSTERWRITER_H
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "crc32c.h"
+#include <string.h>
+
+namespace zim
+{
+  namespace
+  {
+    // Tables for processing 8 bytes per step (slicing-by-8).
+    class Crc32cTable
+    {
+        uint32_t table[8][256];
+        bool hardware;
+
+      public:
+        Crc32cTable();
+
+        uint32_t update(uint32_t crc, const unsigned char* p, std::size_t size) const;
+        bool hasHardware() const   { return hardware; }
+    };
+
+    Crc32cTable::Crc32cTable()
+    {
+      for (unsigned n = 0; n < 256; ++n)
+      {
+        uint32_t c = n;
+        for (unsigned k = 0; k < 8; ++k)
+          c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+        table[0][n] = c;
+      }
+
+      for (unsigned n = 0; n < 256; ++n)
+        for (unsigned s = 1; s < 8; ++s)
+          table[s][n] = (table[s - 1][n] >> 8) ^ table[0][table[s - 1][n] & 0xff];
+
+#if defined(__GNUC__) && defined(__x86_64__)
+      // the cpu model may not be set up yet in a static initializer
+      __builtin_cpu_init();
+      hardware = __builtin_cpu_supports("sse4.2");
+#else
+      hardware = false;
+#endif
+    }
+
+    uint32_t Crc32cTable::update(uint32_t crc, const unsigned char* p, std::size_t size) const
+    {
+      while (size > 0 && (reinterpret_cast<std::size_t>(p) & 7) != 0)
+      {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+        --size;
+      }
+
+      while (size >= 8)
+      {
+        uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24);
+        crc = table[7][lo & 0xff]
+            ^ table[6][(lo >> 8) & 0xff]
+            ^ table[5][(lo >> 16) & 0xff]
+            ^ table[4][lo >> 24]
+            ^ table[3][p[4]]
+            ^ table[2][p[5]]
+            ^ table[1][p[6]]
+            ^ table[0][p[7]];
+        p += 8;
+        size -= 8;
+      }
+
+      while (size-- > 0)
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+
+      return crc;
+    }
+
+    // initialized before main, so that no locking is needed
+    const Crc32cTable crc32cTable;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    __attribute__((target("sse4.2")))
+    uint32_t updateHardware(uint32_t crc, const unsigned char* p, std::size_t size)
+    {
+      while (size > 0 && (reinterpret_cast<std::size_t>(p) & 7) != 0)
+      {
+        crc = __builtin_ia32_crc32qi(crc, *p++);
+        --size;
+      }
+
+      uint64_t c = crc;
+      while (size >= 8)
+      {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __builtin_ia32_crc32di(c, v);
+        p += 8;
+        size -= 8;
+      }
+
+      crc = static_cast<uint32_t>(c);
+      while (size-- > 0)
+        crc = __builtin_ia32_crc32qi(crc, *p++);
+
+      return crc;
+    }
+#endif
+  }
+
+  uint32_t crc32c(uint32_t crc, const char* data, std::size_t size)
+  {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    if (crc32cTable.hasHardware())
+      return ~updateHardware(~crc, p, size);
+#endif
+
+    return ~crc32cTable.update(~crc, p, size);
+  }
+
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_CRC32C_H
+#define ZIM_CRC32C_H
+
+#include <zim/zim.h>
+#include <cstddef>
+
+namespace zim
+{
+  // Calculates the CRC32C (Castagnoli) checksum of the data. The result of
+  // a previous call can be passed as crc to continue the calculation; start
+  // with 0. Uses the crc32 instruction of SSE 4.2, when the cpu has it.
+  uint32_t crc32c(uint32_t crc, const char* data, std::size_t size);
+
+}
+
+#endif // ZIM_CRC32C_H
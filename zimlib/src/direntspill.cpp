@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "direntspill.h"
+#include <zim/endian.h>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <stdio.h>
+#include "log.h"
+
+log_define("zim.writer.direntspill")
+
+namespace zim
+{
+  namespace writer
+  {
+    namespace
+    {
+      void writeSize(std::ostream& out, size_type v)
+      {
+        char d[sizeof(size_type)];
+        toLittleEndian(v, d);
+        out.write(d, sizeof(d));
+      }
+
+      bool readSize(std::istream& in, size_type& v)
+      {
+        size_type d;
+        if (!in.read(reinterpret_cast<char*>(&d), sizeof(d)))
+          return false;
+        v = fromLittleEndian(&d);
+        return true;
+      }
+
+      void openInput(std::ifstream& in, const std::string& fname)
+      {
+        in.open(fname.c_str(), std::ios::in | std::ios::binary);
+        if (!in.is_open())
+          throw std::runtime_error("failed to open temporary file " + fname);
+      }
+    }
+
+    ////////////////////////////////////////////////////////////////////
+    // records
+    //
+    offset_type recordSize(const KeyPos& k)
+    {
+      return sizeof(KeyPos) + k.key.size();
+    }
+
+    void writeRecord(std::ostream& out, const KeyPos& k)
+    {
+      writeSize(out, k.key.size());
+      out.write(k.key.data(), k.key.size());
+      writeSize(out, k.pos);
+    }
+
+    bool readRecord(std::istream& in, KeyPos& k)
+    {
+      size_type len;
+      if (!readSize(in, len))
+        return false;
+      k.key.resize(len);
+      if (len > 0 && !in.read(&k.key[0], len))
+        return false;
+      return readSize(in, k.pos);
+    }
+
+    offset_type recordSize(const Dirent& d)
+    {
+      return sizeof(Dirent) + d.getUrl().size() + d.getTitle().size()
+           + d.getParameter().size() + d.getAid().size() + d.getRedirectAid().size();
+    }
+
+    void writeRecord(std::ostream& out, const Dirent& d)
+    {
+      out << static_cast<const zim::Dirent&>(d)
+          << d.getAid() << '\0'
+          << d.getRedirectAid() << '\0';
+    }
+
+    bool readRecord(std::istream& in, Dirent& d)
+    {
+      if (in.peek() == std::istream::traits_type::eof())
+        return false;
+
+      in >> static_cast<zim::Dirent&>(d);
+
+      std::string aid;
+      std::string redirectAid;
+      std::getline(in, aid, '\0');
+      std::getline(in, redirectAid, '\0');
+      d.setAid(aid);
+      d.setRedirectAid(redirectAid);
+
+      return !in.fail();
+    }
+
+    size_type removeInvalidRedirects(std::vector<size_type>& redirectIdx,
+                                     std::vector<bool>& removed,
+                                     std::vector<size_type>& idx)
+    {
+      size_type pos;
+
+      removed.assign(redirectIdx.size(), false);
+      for (pos = 0; pos < redirectIdx.size(); ++pos)
+        if (redirectIdx[pos] == missingTarget)
+          removed[pos] = true;
+
+      bool changed = true;
+      while (changed)
+      {
+        changed = false;
+        for (pos = 0; pos < redirectIdx.size(); ++pos)
+        {
+          size_type t = redirectIdx[pos];
+          if (!removed[pos] && t != notRedirect && removed[t])
+          {
+            removed[pos] = true;
+            changed = true;
+          }
+        }
+      }
+
+      idx.resize(redirectIdx.size());
+      size_type n = 0;
+      for (pos = 0; pos < redirectIdx.size(); ++pos)
+      {
+        idx[pos] = n;
+        if (!removed[pos])
+          ++n;
+      }
+
+      for (pos = 0; pos < redirectIdx.size(); ++pos)
+      {
+        if (!removed[pos] && redirectIdx[pos] != notRedirect)
+          redirectIdx[pos] = idx[redirectIdx[pos]];
+      }
+
+      return n;
+    }
+
+    ////////////////////////////////////////////////////////////////////
+    // DirentSpill
+    //
+
+    DirentSpill::DirentSpill(const std::string& prefix_, offset_type maxBytes_)
+      : prefix(prefix_),
+        maxBytes(maxBytes_),
+        sorter(prefix_ + ".url", maxBytes_),
+        urlFile(prefix_ + ".sorted"),
+        articleCount(0),
+        direntsSize(0),
+        mainIdx(std::numeric_limits<size_type>::max()),
+        layoutIdx(std::numeric_limits<size_type>::max())
+    {
+    }
+
+    DirentSpill::~DirentSpill()
+    {
+      ::remove(urlFile.c_str());
+    }
+
+    void DirentSpill::finish(const std::string& mainAid, const std::string& layoutAid,
+                             std::vector<size_type>& titleIdx)
+    {
+      log_debug("merge " << sorter.size() << " directory entries from " << sorter.getRunCount() << " runs");
+      sorter.sort();
+      resolveRedirects(mainAid, layoutAid);
+      createTitleIndex(titleIdx);
+    }
+
+    void DirentSpill::resolveRedirects(const std::string& mainAid, const std::string& layoutAid)
+    {
+      ExternalSorter<KeyPos, CompareKey> aids(prefix + ".aid", maxBytes / 2);
+      ExternalSorter<KeyPos, CompareKey> targets(prefix + ".redirect", maxBytes / 2);
+
+      // write the entries in url order and collect the article ids and the
+      // redirect targets with their positions
+      std::ofstream out(urlFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      Dirent dirent;
+      size_type pos = 0;
+      redirectIdx.reserve(sorter.size());
+      while (sorter.next(dirent))
+      {
+        writeRecord(out, dirent);
+        aids.add(KeyPos(dirent.getAid(), pos));
+        if (dirent.isRedirect())
+        {
+          targets.add(KeyPos(dirent.getRedirectAid(), pos));
+          redirectIdx.push_back(missingTarget);
+        }
+        else
+          redirectIdx.push_back(notRedirect);
+        ++pos;
+      }
+
+      out.close();
+      if (out.fail())
+        throw std::runtime_error("failed to write temporary file " + urlFile);
+
+      // find the position of the target of each redirect
+      log_debug("resolve " << targets.size() << " redirects");
+      aids.sort();
+      targets.sort();
+
+      size_type mainPos = notRedirect;
+      size_type layoutPos = notRedirect;
+      KeyPos aid;
+      KeyPos target;
+      bool haveAid = aids.next(aid);
+      bool haveTarget = targets.next(target);
+      while (haveAid)
+      {
+        if (haveTarget && target.key < aid.key)
+        {
+          haveTarget = targets.next(target);
+          continue;
+        }
+
+        if (haveTarget && target.key == aid.key)
+        {
+          redirectIdx[target.pos] = aid.pos;
+          haveTarget = targets.next(target);
+          continue;
+        }
+
+        if (mainPos == notRedirect && aid.key == mainAid)
+          mainPos = aid.pos;
+        if (layoutPos == notRedirect && aid.key == layoutAid)
+          layoutPos = aid.pos;
+
+        haveAid = aids.next(aid);
+      }
+
+      std::vector<size_type> idx;
+      size_type remaining = removeInvalidRedirects(redirectIdx, removed, idx);
+
+      if (mainPos != notRedirect && !removed[mainPos])
+        mainIdx = idx[mainPos];
+      if (layoutPos != notRedirect && !removed[layoutPos])
+        layoutIdx = idx[layoutPos];
+
+      if (remaining < redirectIdx.size())
+        log_debug(redirectIdx.size() - remaining << " invalid redirects removed");
+    }
+
+    void DirentSpill::createTitleIndex(std::vector<size_type>& titleIdx)
+    {
+      ExternalSorter<KeyPos, CompareKey> titles(prefix + ".title", maxBytes);
+
+      std::ifstream in;
+      openInput(in, urlFile);
+
+      Dirent dirent;
+      size_type pos = 0;
+      articleCount = 0;
+      direntsSize = 0;
+      while (readRecord(in, dirent))
+      {
+        if (!removed[pos])
+        {
+          titles.add(KeyPos(std::string(1, dirent.getNamespace()) + dirent.getTitle(), articleCount));
+          direntsSize += dirent.getDirentSize();
+          ++articleCount;
+        }
+        ++pos;
+      }
+
+      if (pos != removed.size())
+        throw std::runtime_error("failed to read temporary file " + urlFile);
+
+      log_debug("sort " << titles.size() << " titles");
+      titles.sort();
+
+      titleIdx.clear();
+      titleIdx.reserve(articleCount);
+      KeyPos title;
+      while (titles.next(title))
+        titleIdx.push_back(title.pos);
+    }
+
+    void DirentSpill::writeUrlPtrs(std::ostream& out, offset_type off)
+    {
+      std::ifstream in;
+      openInput(in, urlFile);
+
+      Dirent dirent;
+      for (size_type pos = 0; readRecord(in, dirent); ++pos)
+      {
+        if (removed[pos])
+          continue;
+
+        offset_type ptr0 = fromLittleEndian<offset_type>(&off);
+        out.write(reinterpret_cast<const char*>(&ptr0), sizeof(ptr0));
+        off += dirent.getDirentSize();
+      }
+    }
+
+    void DirentSpill::writeDirents(std::ostream& out, const std::vector<uint16_t>& mimeMapping)
+    {
+      std::ifstream in;
+      openInput(in, urlFile);
+
+      Dirent dirent;
+      for (size_type pos = 0; readRecord(in, dirent); ++pos)
+      {
+        if (removed[pos])
+          continue;
+
+        if (dirent.isRedirect())
+          dirent.setRedirect(redirectIdx[pos]);
+        else if (dirent.isArticle())
+          dirent.setMimeType(mimeMapping[dirent.getMimeType()]);
+
+        out << static_cast<const zim::Dirent&>(dirent);
+      }
+    }
+
+  }
+}
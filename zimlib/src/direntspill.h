@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_WRITER_DIRENTSPILL_H
+#define ZIM_WRITER_DIRENTSPILL_H
+
+#include <zim/writer/dirent.h>
+#include <zim/noncopyable.h>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <vector>
+#include "externalsort.h"
+
+namespace zim
+{
+  namespace writer
+  {
+    // A string key with the position of the directory entry it belongs to.
+    struct KeyPos
+    {
+      std::string key;
+      size_type pos;
+
+      KeyPos()
+        : pos(0)
+        { }
+
+      KeyPos(const std::string& key_, size_type pos_)
+        : key(key_),
+          pos(pos_)
+        { }
+
+      bool operator< (const KeyPos& k) const
+        { return key < k.key || (key == k.key && pos < k.pos); }
+    };
+
+    offset_type recordSize(const KeyPos& k);
+    void writeRecord(std::ostream& out, const KeyPos& k);
+    bool readRecord(std::istream& in, KeyPos& k);
+
+    offset_type recordSize(const Dirent& d);
+    void writeRecord(std::ostream& out, const Dirent& d);
+    bool readRecord(std::istream& in, Dirent& d);
+
+    // Values in lists of redirect targets for entries, which are no
+    // redirects, and for redirects to missing articles.
+    const size_type notRedirect = std::numeric_limits<size_type>::max();
+    const size_type missingTarget = std::numeric_limits<size_type>::max() - 1;
+
+    // Marks redirects to missing articles and to removed redirects as
+    // removed. redirectIdx holds the position of the target of each
+    // redirect; the positions are translated to the indexes of the
+    // remaining entries. idx receives the index of each position. Returns
+    // the number of remaining entries.
+    size_type removeInvalidRedirects(std::vector<size_type>& redirectIdx,
+                                     std::vector<bool>& removed,
+                                     std::vector<size_type>& idx);
+
+    struct CompareUrl
+    {
+      bool operator() (const Dirent& d1, const Dirent& d2) const
+        { return compareUrl(d1, d2); }
+    };
+
+    struct CompareKey
+    {
+      bool operator() (const KeyPos& k1, const KeyPos& k2) const
+        { return k1 < k2; }
+    };
+
+    /**
+     Directory entries, which are kept in temporary files instead of memory.
+
+     The entries are sorted by url with an external merge sort. Redirects are
+     resolved by merging the sorted list of article ids with the sorted list
+     of redirect targets. The title index is sorted the same way. When the
+     zim file is written, the entries are read back in url order.
+
+     Besides the memory limit about 9 bytes per entry are kept in memory.
+     */
+    class DirentSpill : private NonCopyable
+    {
+        std::string prefix;
+        offset_type maxBytes;
+        ExternalSorter<Dirent, CompareUrl> sorter;
+        std::string urlFile;
+
+        // indexed by the position in url order including invalid redirects
+        std::vector<bool> removed;
+        std::vector<size_type> redirectIdx;
+
+        size_type articleCount;
+        offset_type direntsSize;
+        size_type mainIdx;
+        size_type layoutIdx;
+
+        void resolveRedirects(const std::string& mainAid, const std::string& layoutAid);
+        void createTitleIndex(std::vector<size_type>& titleIdx);
+
+      public:
+        // prefix is used for the names of the temporary files
+        DirentSpill(const std::string& prefix, offset_type maxBytes);
+        ~DirentSpill();
+
+        void add(const Dirent& dirent)   { sorter.add(dirent); }
+
+        // Sorts the entries, removes redirects to missing articles,
+        // translates redirect targets and the main and layout page to
+        // indexes and creates the title index.
+        void finish(const std::string& mainAid, const std::string& layoutAid,
+                    std::vector<size_type>& titleIdx);
+
+        size_type getArticleCount() const   { return articleCount; }
+        offset_type getDirentsSize() const  { return direntsSize; }
+        size_type getMainIdx() const        { return mainIdx; }
+        size_type getLayoutIdx() const      { return layoutIdx; }
+
+        // Writes the url pointer list for entries starting at offset off.
+        void writeUrlPtrs(std::ostream& out, offset_type off);
+
+        // Writes the entries in url order. The mime types are translated
+        // with mimeMapping.
+        void writeDirents(std::ostream& out, const std::vector<uint16_t>& mimeMapping);
+    };
+
+  }
+}
+
+#endif // ZIM_WRITER_DIRENTSPILL_H
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "executor.h"
+#include "envvalue.h"
+#include "log.h"
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+
+log_define("zim.executor")
+
+namespace zim
+{
+  Executor::Executor(unsigned maxThreads_)
+    : maxThreads(maxThreads_ > 0 ? maxThreads_ : 1),
+      idleThreads(0),
+      stop(false)
+  {
+  }
+
+  Executor::~Executor()
+  {
+    MutexLock lock(mutex);
+    stop = true;
+    jobAvailable.broadcast();
+    lock.unlock();
+
+    for (std::vector<pthread_t>::iterator it = threads.begin(); it != threads.end(); ++it)
+      ::pthread_join(*it, 0);
+  }
+
+  Executor& Executor::getInstance()
+  {
+    static Executor executor(envValue("ZIM_ASYNCTHREADS", 4));
+    return executor;
+  }
+
+  void Executor::submit(AsyncJob* job)
+  {
+    MutexLock lock(mutex);
+
+    jobs.push_back(job);
+
+    // A new thread counts as idle, before it has taken a job, so threads
+    // are started, until there is one for each queued job.
+    if (jobs.size() > idleThreads && threads.size() < maxThreads)
+    {
+      pthread_t thread;
+      int ret = ::pthread_create(&thread, 0, threadStart, this);
+      if (ret != 0)
+      {
+        if (threads.empty())
+        {
+          jobs.pop_back();
+          std::ostringstream msg;
+          msg << "failed to create thread; error " << ret << " : " << strerror(ret);
+          throw std::runtime_error(msg.str());
+        }
+
+        log_warn("failed to create thread; error " << ret << " : " << strerror(ret));
+      }
+      else
+      {
+        log_debug("thread " << threads.size() << " started");
+        threads.push_back(thread);
+        ++idleThreads;
+      }
+    }
+
+    jobAvailable.signal();
+  }
+
+  void* Executor::threadStart(void* arg)
+  {
+    static_cast<Executor*>(arg)->runJobs();
+    return 0;
+  }
+
+  void Executor::runJobs()
+  {
+    MutexLock lock(mutex);
+
+    while (true)
+    {
+      while (jobs.empty() && !stop)
+        jobAvailable.wait(mutex);
+
+      if (jobs.empty())
+        break;
+
+      SmartPtr<AsyncJob> job = jobs.front();
+      jobs.pop_front();
+      --idleThreads;
+
+      lock.unlock();
+      job->run();
+      lock.lock();
+
+      ++idleThreads;
+    }
+  }
+
+}
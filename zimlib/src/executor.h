@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_EXECUTOR_H
+#define ZIM_EXECUTOR_H
+
+#include <zim/async.h>
+#include <zim/mutex.h>
+#include <zim/noncopyable.h>
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+namespace zim
+{
+  /**
+   Thread pool, which processes asynchronous requests.
+
+   Threads are started on demand up to the maximum number of threads, which
+   is read from the environment variable ZIM_ASYNCTHREADS.
+   */
+  class Executor : private NonCopyable
+  {
+      typedef std::deque<SmartPtr<AsyncJob> > Jobs;
+
+      Mutex mutex;
+      Condition jobAvailable;
+      Jobs jobs;
+      std::vector<pthread_t> threads;
+      unsigned maxThreads;
+      unsigned idleThreads;
+      bool stop;
+
+      static void* threadStart(void* arg);
+      void runJobs();
+
+    public:
+      explicit Executor(unsigned maxThreads);
+      ~Executor();
+
+      void submit(AsyncJob* job);
+
+      static Executor& getInstance();
+  };
+
+}
+
+#endif // ZIM_EXECUTOR_H
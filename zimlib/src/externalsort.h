@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_EXTERNALSORT_H
+#define ZIM_EXTERNALSORT_H
+
+#include <zim/zim.h>
+#include <zim/noncopyable.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+namespace zim
+{
+  /**
+   Sorts more records than fit into memory.
+
+   Records are collected until their size exceeds the memory limit. Then
+   they are sorted and written as a run to a temporary file. After all
+   records are added, the runs are merged while the records are read with
+   next. When all records fit into memory, no file is written.
+
+   At most maxMerge runs are opened at the same time. When there are more
+   runs, groups of them are merged into new runs first, so that the number
+   of open files stays limited however small the memory limit is.
+
+   The record type must provide these functions:
+
+     offset_type recordSize(const Record&);    // estimated memory usage
+     void writeRecord(std::ostream&, const Record&);
+     bool readRecord(std::istream&, Record&);  // false on error
+
+   readRecord is not called at the end of a file, so a record, which cannot
+   be read completely, is reported as an error and not taken as the end of
+   a run.
+   */
+  template <typename Record, typename Compare>
+  class ExternalSorter : private NonCopyable
+  {
+      typedef std::vector<Record> Records;
+
+      // orders the indexes of the runs by their current record, so that
+      // the smallest is on top of the heap
+      class HeapCompare
+      {
+          const Records& heads;
+          Compare compare;
+
+        public:
+          HeapCompare(const Records& heads_, Compare compare_)
+            : heads(heads_),
+              compare(compare_)
+            { }
+
+          bool operator() (unsigned a, unsigned b) const
+            { return compare(heads[b], heads[a]); }
+      };
+
+      std::string prefix;
+      offset_type maxBytes;
+      unsigned maxMerge;
+      Compare compare;
+
+      Records records;
+      offset_type bytes;
+      typename Records::size_type nextRecord;
+      size_type count;
+
+      std::vector<std::string> runs;
+      unsigned runNumber;
+      std::vector<std::ifstream*> inputs;
+      Records heads;
+      std::vector<unsigned> heap;
+
+      std::string runName();
+      void spill();
+      void openRuns(unsigned count);
+      void closeRuns();
+      bool readRun(unsigned n);
+      bool nextMerged(Record& record);
+      void mergeRuns(unsigned count);
+
+    public:
+      ExternalSorter(const std::string& prefix_, offset_type maxBytes_, Compare compare_ = Compare())
+        : prefix(prefix_),
+          maxBytes(maxBytes_),
+          maxMerge(64),
+          compare(compare_),
+          bytes(0),
+          nextRecord(0),
+          count(0),
+          runNumber(0)
+        { }
+
+      ~ExternalSorter();
+
+      void add(const Record& record)
+      {
+        records.push_back(record);
+        bytes += recordSize(record);
+        ++count;
+        if (bytes > maxBytes)
+          spill();
+      }
+
+      // Ends adding records and prepares reading them in sorted order.
+      void sort();
+
+      // Reads the next record in sorted order. Returns false at the end.
+      bool next(Record& record);
+
+      size_type size() const          { return count; }
+      unsigned getRunCount() const    { return runs.size(); }
+
+      // sets the maximum number of runs, which are merged at once
+      void setMaxMerge(unsigned n)    { maxMerge = n < 2 ? 2 : n; }
+      unsigned getMaxMerge() const    { return maxMerge; }
+  };
+
+  template <typename Record, typename Compare>
+  ExternalSorter<Record, Compare>::~ExternalSorter()
+  {
+    closeRuns();
+    for (std::vector<std::string>::const_iterator it = runs.begin(); it != runs.end(); ++it)
+      ::remove(it->c_str());
+  }
+
+  template <typename Record, typename Compare>
+  std::string ExternalSorter<Record, Compare>::runName()
+  {
+    std::ostringstream fname;
+    fname << prefix << '.' << runNumber++;
+    return fname.str();
+  }
+
+  template <typename Record, typename Compare>
+  void ExternalSorter<Record, Compare>::spill()
+  {
+    std::sort(records.begin(), records.end(), compare);
+
+    std::string fname = runName();
+    runs.push_back(fname);
+
+    std::ofstream out(fname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    for (typename Records::const_iterator it = records.begin(); it != records.end(); ++it)
+      writeRecord(out, *it);
+    out.close();
+
+    if (out.fail())
+      throw std::runtime_error("failed to write temporary file " + fname);
+
+    // release the memory
+    Records().swap(records);
+    bytes = 0;
+  }
+
+  // opens the first count runs and reads their first records
+  template <typename Record, typename Compare>
+  void ExternalSorter<Record, Compare>::openRuns(unsigned count)
+  {
+    heads.resize(count);
+    for (unsigned n = 0; n < count; ++n)
+    {
+      std::ifstream* in = new std::ifstream(runs[n].c_str(), std::ios::in | std::ios::binary);
+      inputs.push_back(in);
+      if (!in->is_open())
+        throw std::runtime_error("failed to open temporary file " + runs[n]);
+
+      if (readRun(n))
+        heap.push_back(n);
+    }
+
+    std::make_heap(heap.begin(), heap.end(), HeapCompare(heads, compare));
+  }
+
+  template <typename Record, typename Compare>
+  void ExternalSorter<Record, Compare>::closeRuns()
+  {
+    for (typename std::vector<std::ifstream*>::iterator it = inputs.begin(); it != inputs.end(); ++it)
+      delete *it;
+    inputs.clear();
+    heads.clear();
+    heap.clear();
+  }
+
+  // reads the next record of run n into heads[n]; returns false at the end
+  // of the run
+  template <typename Record, typename Compare>
+  bool ExternalSorter<Record, Compare>::readRun(unsigned n)
+  {
+    std::istream& in = *inputs[n];
+    if (in.peek() == std::istream::traits_type::eof() && !in.bad())
+      return false;
+
+    if (!readRecord(in, heads[n]))
+      throw std::runtime_error("failed to read temporary file " + runs[n]);
+
+    return true;
+  }
+
+  template <typename Record, typename Compare>
+  bool ExternalSorter<Record, Compare>::nextMerged(Record& record)
+  {
+    if (heap.empty())
+      return false;
+
+    HeapCompare heapCompare(heads, compare);
+    std::pop_heap(heap.begin(), heap.end(), heapCompare);
+    unsigned n = heap.back();
+    std::swap(record, heads[n]);
+    if (readRun(n))
+      std::push_heap(heap.begin(), heap.end(), heapCompare);
+    else
+      heap.pop_back();
+
+    return true;
+  }
+
+  // merges the first count runs into a new run at the end
+  template <typename Record, typename Compare>
+  void ExternalSorter<Record, Compare>::mergeRuns(unsigned count)
+  {
+    std::string fname = runName();
+    std::ofstream out(fname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    openRuns(count);
+    Record record;
+    while (nextMerged(record))
+      writeRecord(out, record);
+    closeRuns();
+
+    out.close();
+    if (out.fail())
+    {
+      ::remove(fname.c_str());
+      throw std::runtime_error("failed to write temporary file " + fname);
+    }
+
+    for (unsigned n = 0; n < count; ++n)
+      ::remove(runs[n].c_str());
+    runs.erase(runs.begin(), runs.begin() + count);
+    runs.push_back(fname);
+  }
+
+  template <typename Record, typename Compare>
+  void ExternalSorter<Record, Compare>::sort()
+  {
+    if (runs.empty())
+    {
+      std::sort(records.begin(), records.end(), compare);
+      nextRecord = 0;
+      return;
+    }
+
+    if (!records.empty())
+      spill();
+
+    while (runs.size() > maxMerge)
+      mergeRuns(maxMerge);
+
+    openRuns(runs.size());
+  }
+
+  template <typename Record, typename Compare>
+  bool ExternalSorter<Record, Compare>::next(Record& record)
+  {
+    if (runs.empty())
+    {
+      if (nextRecord >= records.size())
+        return false;
+      record = records[nextRecord++];
+      return true;
+    }
+
+    return nextMerged(record);
+  }
+
+}
+
+#endif // ZIM_EXTERNALSORT_H
@@ -201,6 +201,14 @@ namespace zim
   File::const_iterator File::findByTitle(char ns, const std::string& title)
   { return findxByTitle(ns, title).second; }
 
+  void File::prefetch(char ns, const std::string& url)
+  {
+    log_trace("File::prefetch('" << ns << "', \"" << url << ')');
+    std::pair<bool, const_iterator> r = findx(ns, url);
+    if (r.first)
+      prefetch(r.second.getIndex());
+  }
+
   offset_type File::getOffset(size_type clusterIdx, size_type blobIdx)
   {
     Cluster cluster = getCluster(clusterIdx);
@@ -209,6 +217,14 @@ namespace zim
     return cluster.getBlobOffset(blobIdx);
   }
 
+  FileRegion File::getFileRegion(size_type clusterIdx, size_type blobIdx)
+  {
+    Cluster cluster = getCluster(clusterIdx);
+    if (cluster.isCompressed())
+      return FileRegion();
+    return impl->getFileRegion(cluster.getBlobOffset(blobIdx), cluster.getBlobSize(blobIdx));
+  }
+
   std::string urldecode(const std::string& url)
   {
     std::string ret;
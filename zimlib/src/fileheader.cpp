@@ -29,6 +29,8 @@ namespace zim
   const size_type Fileheader::zimMagic = 0x044d495a; // ="ZIM^d"
   const size_type Fileheader::zimVersion = 5;
   const size_type Fileheader::size = 80;
+  const char Fileheader::checksumTableNamespace = 'M';
+  const char Fileheader::checksumTableUrl[] = "ClusterChecksums";
 
   std::ostream& operator<< (std::ostream& out, const Fileheader& fh)
   {
@@ -21,28 +21,74 @@
 #include <zim/error.h>
 #include <zim/dirent.h>
 #include <zim/endian.h>
+#include <zim/blob.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sstream>
 #include <errno.h>
 #include <cstring>
+#include <algorithm>
 #include "config.h"
 #include "log.h"
 #include "envvalue.h"
-#include "md5stream.h"
+#include "md5.h"
+#include "blockreader.h"
+#include "crc32c.h"
+#include <pthread.h>
+#include <unistd.h>
+#include "ptrstream.h"
 
 log_define("zim.file.impl")
 
 namespace zim
 {
+  namespace
+  {
+    // number of consecutive accesses after which access is considered sequential
+    const unsigned sequentialRun = 4;
+
+    // number of url pointers read at once when dirents are read sequentially
+    const size_type urlPtrBlockSize = 1024;
+
+    // number of bytes read for a dirent in batched reads; dirents, which
+    // are longer, are read again using the stream
+    const unsigned direntReadSize = 256;
+  }
+
+  //////////////////////////////////////////////////////////////////////
+  // FileImpl::AccessTracker
+  //
+  void FileImpl::AccessTracker::access(size_type idx)
+  {
+    if (idx == lastIdx || idx == lastIdx + 1)
+    {
+      if (run < sequentialRun)
+        ++run;
+    }
+    else
+      run = 0;
+
+    lastIdx = idx;
+  }
+
+  bool FileImpl::AccessTracker::isSequential() const
+  {
+    return run >= sequentialRun;
+  }
+
   //////////////////////////////////////////////////////////////////////
   // FileImpl
   //
   FileImpl::FileImpl(const char* fname)
     : zimFile(fname),
+      mutex(true),
       direntCache(envValue("ZIM_DIRENTCACHE", DIRENT_CACHE_SIZE)),
       clusterCache(envValue("ZIM_CLUSTERCACHE", CLUSTER_CACHE_SIZE)),
-      cacheUncompressedCluster(envValue("ZIM_CACHEUNCOMPRESSEDCLUSTER", false))
+      cacheUncompressedCluster(envValue("ZIM_CACHEUNCOMPRESSEDCLUSTER", false)),
+      accessPattern(streambuf::accessNormal),
+      urlPtrBlockStart(0),
+      clusterChecksumsRead(false),
+      verifyClusterReads(envValue("ZIM_VERIFYCLUSTERS", false))
   {
     log_trace("read file \"" << fname << '"');
 
@@ -88,9 +134,9 @@ namespace zim
 
   Dirent FileImpl::getDirent(size_type idx)
   {
-    log_trace("FileImpl::getDirent(" << idx << ')');
+    MutexLock lock(mutex);
 
-    zimFile.setBufsize(64);
+    log_trace("FileImpl::getDirent(" << idx << ')');
 
     if (idx >= getCountArticles())
       throw ZimFileFormatError("article index out of range");
@@ -110,7 +156,13 @@ namespace zim
 
     log_debug("dirent " << idx << " not found in cache; hits " << direntCache.getHits() << " misses " << direntCache.getMisses() << " ratio " << direntCache.hitRatio() * 100 << "% fillfactor " << direntCache.fillfactor());
 
-    offset_type indexOffset = getOffset(header.getUrlPtrPos(), idx);
+    direntAccess.access(idx);
+    updateAccessPattern();
+
+    // sequential reads are served from a larger buffer
+    zimFile.setBufsize(direntAccess.isSequential() ? 16384 : 64);
+
+    offset_type indexOffset = getDirentOffset(idx);
 
     zimFile.seekg(indexOffset);
     if (!zimFile)
@@ -134,8 +186,74 @@ namespace zim
     return dirent;
   }
 
+  std::vector<Dirent> FileImpl::getDirents(const std::vector<size_type>& indexes)
+  {
+    MutexLock lock(mutex);
+
+    log_trace("FileImpl::getDirents(" << indexes.size() << " indexes)");
+
+    std::vector<Dirent> dirents(indexes.size());
+
+    // collect dirents not found in cache
+    std::vector<size_type> missing;
+    std::vector<unsigned> missingPos;
+    for (unsigned n = 0; n < indexes.size(); ++n)
+    {
+      if (indexes[n] >= getCountArticles())
+        throw ZimFileFormatError("article index out of range");
+
+      std::pair<bool, Dirent> v = direntCache.getx(indexes[n]);
+      if (v.first)
+        dirents[n] = v.second;
+      else
+      {
+        missing.push_back(indexes[n]);
+        missingPos.push_back(n);
+      }
+    }
+
+    if (missing.empty())
+      return dirents;
+
+    log_debug(missing.size() << " of " << indexes.size() << " dirents not found in cache");
+
+    // The reads of one lookup depend on each other, but the reads of
+    // different dirents do not. So all url pointers are read in one batch
+    // and then all dirents in a second one.
+    std::vector<offset_type> offsets;
+    readOffsets(header.getUrlPtrPos(), missing, offsets);
+
+    std::vector<char> data(missing.size() * direntReadSize);
+    streambuf::ReadRequests requests(missing.size());
+    for (unsigned n = 0; n < missing.size(); ++n)
+      requests[n] = streambuf::ReadRequest(offsets[n], &data[n * direntReadSize], direntReadSize);
+    zimFile.readBatch(requests);
+
+    for (unsigned n = 0; n < missing.size(); ++n)
+    {
+      Dirent dirent;
+      char* p = &data[n * direntReadSize];
+      ptrstream in(p, p + requests[n].count);
+      in >> dirent;
+
+      if (in.fail())
+      {
+        log_debug("dirent " << missing[n] << " longer than " << direntReadSize << " bytes");
+        dirent = getDirent(missing[n]);
+      }
+      else
+        direntCache.put(missing[n], dirent);
+
+      dirents[missingPos[n]] = dirent;
+    }
+
+    return dirents;
+  }
+
   Dirent FileImpl::getDirentByTitle(size_type idx)
   {
+    MutexLock lock(mutex);
+
     if (idx >= getCountArticles())
       throw ZimFileFormatError("article index out of range");
     return getDirent(getIndexByTitle(idx));
@@ -143,6 +261,8 @@ namespace zim
 
   size_type FileImpl::getIndexByTitle(size_type idx)
   {
+    MutexLock lock(mutex);
+
     if (idx >= getCountArticles())
       throw ZimFileFormatError("article index out of range");
 
@@ -161,6 +281,8 @@ namespace zim
 
   Cluster FileImpl::getCluster(size_type idx)
   {
+    MutexLock lock(mutex);
+
     log_trace("getCluster(" << idx << ')');
 
     if (idx >= getCountClusters())
@@ -173,9 +295,83 @@ namespace zim
       return cluster;
     }
 
-    zimFile.setBufsize(16384);
+    // wait for another thread, which already loads the cluster
+    MutexLock loadLock(loadMutex);
+    ClusterLoads::iterator it = clusterLoads.find(idx);
+    if (it != clusterLoads.end())
+    {
+      SmartPtr<ClusterLoad> load = it->second;
+      lock.unlock();
+
+      log_debug("wait for cluster " << idx);
+      while (!load->done)
+        clusterLoaded.wait(loadMutex);
+
+      if (!load->error.empty())
+        throw ZimFileFormatError(load->error);
+      return load->cluster;
+    }
+    loadLock.unlock();
+
+    clusterAccess.access(idx);
+    updateAccessPattern();
 
     offset_type clusterOffset = getClusterOffset(idx);
+
+    if (clusterAccess.isSequential())
+    {
+      zimFile.setBufsize(262144);
+
+      // let the kernel read the next cluster while this one is processed
+      if (idx + 1 < getCountClusters())
+        prefetchCluster(idx + 1);
+    }
+    else
+    {
+      zimFile.setBufsize(16384);
+
+      // In random mode the kernel does no readahead at all, so request
+      // exactly the range of the cluster instead of waiting for each
+      // buffer fill.
+      offset_type clusterEnd = getClusterEnd(idx);
+      if (clusterEnd > clusterOffset)
+        zimFile.prefetch(clusterOffset, clusterEnd - clusterOffset);
+    }
+
+    // the checksum is checked on the data read for loading the cluster
+    bool verify = false;
+    uint32_t checksum = 0;
+    if (verifyClusterReads)
+    {
+      readClusterChecksums();
+      if (idx < clusterChecksums.size())
+      {
+        verify = true;
+        checksum = clusterChecksums[idx];
+      }
+    }
+
+    // Compressed and verified clusters are read and uncompressed without
+    // holding the mutex, so that other threads can access the file
+    // meanwhile.
+    char compression;
+    if (zimFile.readAt(&compression, clusterOffset, 1) != 1)
+      throw ZimFileFormatError("error reading cluster data");
+
+    if (verify || compression == zimcompZip || compression == zimcompBzip2 || compression == zimcompLzma)
+    {
+      offset_type clusterEnd = getClusterEnd(idx);
+      if (clusterEnd <= clusterOffset)
+        throw ZimFileFormatError("invalid cluster offset");
+
+      loadLock.lock();
+      clusterLoads[idx] = new ClusterLoad();
+      loadLock.unlock();
+      lock.unlock();
+
+      return loadCluster(idx, clusterOffset, clusterEnd, verify, checksum);
+    }
+
     log_debug("read cluster " << idx << " from offset " << clusterOffset);
     cluster.init_from_stream(zimFile, clusterOffset);
 
@@ -193,8 +389,227 @@ namespace zim
     return cluster;
   }
 
+  void FileImpl::prefetchArticle(size_type idx)
+  {
+    MutexLock lock(mutex);
+
+    log_trace("prefetchArticle(" << idx << ')');
+
+    Dirent dirent = getDirent(idx);
+    if (dirent.isRedirect() && dirent.getRedirectIndex() < getCountArticles())
+      dirent = getDirent(dirent.getRedirectIndex());
+
+    if (dirent.isArticle())
+      prefetchCluster(dirent.getClusterNumber());
+  }
+
+  void FileImpl::prefetchCluster(size_type idx)
+  {
+    MutexLock lock(mutex);
+
+    log_trace("prefetchCluster(" << idx << ')');
+
+    if (idx >= getCountClusters())
+      throw ZimFileFormatError("cluster index out of range");
+
+    if (clusterCache.contains(idx))
+    {
+      log_debug("cluster " << idx << " already in cache");
+      return;
+    }
+
+    offset_type clusterOffset = getClusterOffset(idx);
+    offset_type clusterEnd = getClusterEnd(idx);
+    if (clusterEnd > clusterOffset)
+      zimFile.prefetch(clusterOffset, clusterEnd - clusterOffset);
+  }
+
+  void FileImpl::prefetchClusters(const std::vector<size_type>& indexes)
+  {
+    MutexLock lock(mutex);
+
+    log_trace("prefetchClusters(" << indexes.size() << " indexes)");
+
+    // read the begin and end offset of all clusters in one batch
+    std::vector<size_type> ptrs;
+    for (std::vector<size_type>::const_iterator it = indexes.begin(); it != indexes.end(); ++it)
+    {
+      if (*it >= getCountClusters())
+        throw ZimFileFormatError("cluster index out of range");
+
+      if (clusterCache.contains(*it))
+        continue;
+
+      ptrs.push_back(*it);
+      if (*it + 1 < getCountClusters())
+        ptrs.push_back(*it + 1);
+    }
+
+    std::vector<offset_type> offsets;
+    readOffsets(header.getClusterPtrPos(), ptrs, offsets);
+
+    for (unsigned n = 0; n < ptrs.size(); ++n)
+    {
+      size_type idx = ptrs[n];
+      offset_type clusterOffset = offsets[n];
+      offset_type clusterEnd;
+      if (idx + 1 < getCountClusters())
+        clusterEnd = offsets[++n];
+      else
+        clusterEnd = getClusterEnd(idx);
+
+      if (clusterEnd > clusterOffset)
+        zimFile.prefetch(clusterOffset, clusterEnd - clusterOffset);
+    }
+  }
+
+  // Called without holding the mutex after an entry for the cluster is
+  // added to clusterLoads.
+  Cluster FileImpl::loadCluster(size_type idx, offset_type offset, offset_type end,
+                                bool verify, uint32_t checksum)
+  {
+    log_debug("read cluster " << idx << " from offset " << offset);
+
+    Cluster cluster;
+    std::string error;
+    try
+    {
+      std::vector<char> data(end - offset);
+      if (zimFile.readAt(&data[0], offset, data.size()) != data.size())
+        throw ZimFileFormatError("error reading cluster data");
+
+      if (verify && crc32c(0, &data[0], data.size()) != checksum)
+      {
+        std::ostringstream msg;
+        msg << "checksum error in cluster " << idx;
+        throw ZimFileFormatError(msg.str());
+      }
+
+      cluster.init_from_buffer(&data[0], data.size());
+    }
+    catch (const std::exception& e)
+    {
+      error = e.what();
+    }
+
+    // Waiting threads get the result without locking the mutex, since
+    // they may hold it recursively.
+    MutexLock loadLock(loadMutex);
+    SmartPtr<ClusterLoad> load = clusterLoads[idx];
+    load->cluster = cluster;
+    load->error = error;
+    load->done = true;
+    clusterLoaded.broadcast();
+    loadLock.unlock();
+
+    MutexLock lock(mutex);
+    if (error.empty() && (cacheUncompressedCluster || cluster.isCompressed()))
+    {
+      log_debug("put cluster " << idx << " into cluster cache; hits " << clusterCache.getHits() << " misses " << clusterCache.getMisses() << " ratio " << clusterCache.hitRatio() * 100 << "% fillfactor " << clusterCache.fillfactor());
+      clusterCache.put(idx, cluster);
+    }
+
+    loadLock.lock();
+    clusterLoads.erase(idx);
+    loadLock.unlock();
+
+    if (!error.empty())
+      throw ZimFileFormatError(error);
+
+    return cluster;
+  }
+
+  offset_type FileImpl::getClusterEnd(size_type idx)
+  {
+    if (idx + 1 < getCountClusters())
+      return getClusterOffset(idx + 1);
+
+    // the last cluster ends, where the next section of the file starts
+    offset_type start = getClusterOffset(idx);
+    offset_type end = header.hasChecksum() ? header.getChecksumPos() : zimFile.fsize();
+    offset_type sections[] = { header.getUrlPtrPos(), header.getTitleIdxPos(), header.getClusterPtrPos() };
+    for (unsigned n = 0; n < sizeof(sections) / sizeof(sections[0]); ++n)
+      if (sections[n] > start && sections[n] < end)
+        end = sections[n];
+
+    return end;
+  }
+
+  offset_type FileImpl::getDirentOffset(size_type idx)
+  {
+    if (!direntAccess.isSequential())
+      return getOffset(header.getUrlPtrPos(), idx);
+
+    // When iterating, the url pointers are read in blocks, so that reading
+    // the dirents does not alternate between the pointer list and the
+    // directory entries.
+    if (urlPtrBlock.empty()
+      || idx < urlPtrBlockStart
+      || idx >= urlPtrBlockStart + urlPtrBlock.size())
+    {
+      size_type count = std::min(urlPtrBlockSize, getCountArticles() - idx);
+      log_debug("read " << count << " url pointers starting at " << idx);
+
+      urlPtrBlock.resize(count);
+      zimFile.seekg(header.getUrlPtrPos() + sizeof(offset_type) * idx);
+      zimFile.read(reinterpret_cast<char*>(&urlPtrBlock[0]), sizeof(offset_type) * count);
+      if (!zimFile)
+      {
+        urlPtrBlock.clear();
+        throw ZimFileFormatError("error reading offset");
+      }
+
+      if (isBigEndian())
+        for (size_type n = 0; n < count; ++n)
+          urlPtrBlock[n] = fromLittleEndian(&urlPtrBlock[n]);
+
+      urlPtrBlockStart = idx;
+    }
+
+    return urlPtrBlock[idx - urlPtrBlockStart];
+  }
+
+  void FileImpl::updateAccessPattern()
+  {
+    streambuf::AccessPattern pattern =
+      direntAccess.isSequential() || clusterAccess.isSequential() ? streambuf::accessSequential
+                                                                  : streambuf::accessRandom;
+    if (pattern != accessPattern)
+    {
+      log_debug("access pattern changed to " << (pattern == streambuf::accessSequential ? "sequential" : "random"));
+      zimFile.setAccessPattern(pattern);
+      accessPattern = pattern;
+    }
+  }
+
+  void FileImpl::readOffsets(offset_type ptrOffset, const std::vector<size_type>& indexes,
+                             std::vector<offset_type>& offsets)
+  {
+    offsets.resize(indexes.size());
+    if (indexes.empty())
+      return;
+
+    streambuf::ReadRequests requests(indexes.size());
+    for (unsigned n = 0; n < indexes.size(); ++n)
+      requests[n] = streambuf::ReadRequest(ptrOffset + sizeof(offset_type) * indexes[n],
+                                           reinterpret_cast<char*>(&offsets[n]), sizeof(offset_type));
+
+    zimFile.readBatch(requests);
+
+    for (unsigned n = 0; n < indexes.size(); ++n)
+    {
+      if (requests[n].count != sizeof(offset_type))
+        throw ZimFileFormatError("error reading offset");
+
+      if (isBigEndian())
+        offsets[n] = fromLittleEndian(&offsets[n]);
+    }
+  }
+
   offset_type FileImpl::getOffset(offset_type ptrOffset, size_type idx)
   {
+    MutexLock lock(mutex);
+
     zimFile.seekg(ptrOffset + sizeof(offset_type) * idx);
     offset_type offset;
     zimFile.read(reinterpret_cast<char*>(&offset), sizeof(offset_type));
@@ -210,6 +625,8 @@ namespace zim
 
   size_type FileImpl::getNamespaceBeginOffset(char ch)
   {
+    MutexLock lock(mutex);
+
     log_trace("getNamespaceBeginOffset(" << ch << ')');
 
     NamespaceCache::const_iterator it = namespaceBeginCache.find(ch);
@@ -237,6 +654,8 @@ namespace zim
 
   size_type FileImpl::getNamespaceEndOffset(char ch)
   {
+    MutexLock lock(mutex);
+
     log_trace("getNamespaceEndOffset(" << ch << ')');
 
     NamespaceCache::const_iterator it = namespaceEndCache.find(ch);
@@ -265,6 +684,8 @@ namespace zim
 
   std::string FileImpl::getNamespaces()
   {
+    MutexLock lock(mutex);
+
     if (namespaces.empty())
     {
       Dirent d = getDirent(0);
@@ -293,8 +714,29 @@ namespace zim
     return mimeTypes[idx];
   }
 
+  SmartPtr<CompiledTemplate> FileImpl::getLayoutTemplate()
+  {
+    MutexLock lock(mutex);
+
+    if (!layoutTemplate && header.hasLayoutPage())
+    {
+      log_debug("compile layout page " << header.getLayoutPage());
+
+      Dirent dirent = getDirent(header.getLayoutPage());
+      Blob data;
+      if (!dirent.isRedirect() && !dirent.isLinktarget() && !dirent.isDeleted())
+        data = getCluster(dirent.getClusterNumber()).getBlob(dirent.getBlobNumber());
+
+      layoutTemplate = new CompiledTemplate(data.data(), data.size());
+    }
+
+    return layoutTemplate;
+  }
+
   std::string FileImpl::getChecksum()
   {
+    MutexLock lock(mutex);
+
     if (!header.hasChecksum())
       return std::string();
 
@@ -320,27 +762,261 @@ namespace zim
     return hexdigest;
   }
 
-  bool FileImpl::verify()
+  namespace
+  {
+    // Calculates the checksum of the given range of the file.
+    uint32_t checksumRange(ifstream& file, offset_type offset, offset_type end, std::vector<char>& buffer)
+    {
+      uint32_t crc = 0;
+      while (offset < end)
+      {
+        unsigned count = end - offset < buffer.size() ? end - offset : buffer.size();
+        if (file.readAt(&buffer[0], offset, count) != count)
+          throw ZimFileFormatError("unexpected end of file");
+        crc = crc32c(crc, &buffer[0], count);
+        offset += count;
+      }
+
+      return crc;
+    }
+
+    // Checks the clusters of the checksum table in multiple threads. The
+    // threads take the next unchecked cluster, so that large and small
+    // clusters are spread evenly.
+    class ClusterVerifier
+    {
+        ifstream& file;
+        const std::vector<uint32_t>& checksums;
+        const std::vector<offset_type>& offsets;  // one more than checksums
+        size_type next;
+        offset_type done;
+
+        Mutex mutex;
+        std::vector<size_type> corrupt;
+        std::string error;
+
+        static void* threadStart(void* arg);
+
+      public:
+        ClusterVerifier(ifstream& file_, const std::vector<uint32_t>& checksums_,
+                        const std::vector<offset_type>& offsets_)
+          : file(file_),
+            checksums(checksums_),
+            offsets(offsets_),
+            next(0),
+            done(0)
+          { }
+
+        void work(VerifyProgress* progress);
+        void run(unsigned threads, VerifyProgress* progress);
+
+        const std::vector<size_type>& getCorrupt() const  { return corrupt; }
+    };
+
+    void* ClusterVerifier::threadStart(void* arg)
+    {
+      static_cast<ClusterVerifier*>(arg)->work(0);
+      return 0;
+    }
+
+    void ClusterVerifier::work(VerifyProgress* progress)
+    {
+      std::vector<char> buffer(1024 * 1024);
+      offset_type total = offsets.back() - offsets.front();
+
+      try
+      {
+        size_type idx;
+        while ((idx = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED)) < checksums.size())
+        {
+          if (checksumRange(file, offsets[idx], offsets[idx + 1], buffer) != checksums[idx])
+          {
+            log_warn("checksum error in cluster " << idx);
+            MutexLock lock(mutex);
+            corrupt.push_back(idx);
+          }
+
+          offset_type d = __atomic_add_fetch(&done, offsets[idx + 1] - offsets[idx], __ATOMIC_RELAXED);
+          if (progress)
+            progress->onProgress(d, total);
+        }
+      }
+      catch (const std::exception& e)
+      {
+        MutexLock lock(mutex);
+        if (error.empty())
+          error = e.what();
+        __atomic_store_n(&next, checksums.size(), __ATOMIC_RELAXED);
+      }
+    }
+
+    void ClusterVerifier::run(unsigned threads, VerifyProgress* progress)
+    {
+      // the calling thread works too, so that it can report the progress
+      std::vector<pthread_t> workers;
+      for (unsigned n = 1; n < threads; ++n)
+      {
+        pthread_t thread;
+        int ret = ::pthread_create(&thread, 0, threadStart, this);
+        if (ret != 0)
+        {
+          log_warn("failed to create thread; error " << ret << " : " << strerror(ret));
+          break;
+        }
+        workers.push_back(thread);
+      }
+
+      work(progress);
+
+      for (std::vector<pthread_t>::iterator it = workers.begin(); it != workers.end(); ++it)
+        ::pthread_join(*it, 0);
+
+      if (!error.empty())
+        throw ZimFileFormatError(error);
+
+      std::sort(corrupt.begin(), corrupt.end());
+    }
+  }
+
+  void FileImpl::readClusterChecksums()
+  {
+    MutexLock lock(mutex);
+
+    if (clusterChecksumsRead)
+      return;
+
+    // set first, since reading the table reads its cluster
+    clusterChecksumsRead = true;
+
+    if (getCountArticles() == 0)
+      return;
+
+    char ns = Fileheader::checksumTableNamespace;
+    std::string url = Fileheader::checksumTableUrl;
+    size_type lower = getNamespaceBeginOffset(ns);
+    size_type upper = getNamespaceEndOffset(ns);
+    while (lower < upper)
+    {
+      size_type m = lower + (upper - lower) / 2;
+      if (getDirent(m).getUrl() < url)
+        lower = m + 1;
+      else
+        upper = m;
+    }
+
+    if (lower >= getNamespaceEndOffset(ns))
+      return;
+
+    Dirent dirent = getDirent(lower);
+    if (dirent.getUrl() != url || !dirent.isArticle())
+      return;
+
+    Blob data = getCluster(dirent.getClusterNumber()).getBlob(dirent.getBlobNumber());
+    if (data.size() < sizeof(uint32_t))
+      throw ZimFileFormatError("invalid cluster checksum table");
+
+    uint32_t count = fromLittleEndian(reinterpret_cast<const uint32_t*>(data.data()));
+    // the table is in the last cluster and covers all others
+    if (count + 1 != getCountClusters() || data.size() != (count + 1) * sizeof(uint32_t))
+      throw ZimFileFormatError("invalid cluster checksum table");
+
+    ChecksumsType checksums(count);
+    for (uint32_t n = 0; n < count; ++n)
+      checksums[n] = fromLittleEndian(reinterpret_cast<const uint32_t*>(data.data() + (n + 1) * sizeof(uint32_t)));
+
+    log_debug("checksum table of " << count << " clusters read");
+    clusterChecksums.swap(checksums);
+  }
+
+  size_type FileImpl::getClusterChecksumCount()
+  {
+    readClusterChecksums();
+    return clusterChecksums.size();
+  }
+
+  bool FileImpl::verifyCluster(size_type idx)
+  {
+    MutexLock lock(mutex);
+
+    readClusterChecksums();
+    if (idx >= clusterChecksums.size())
+      return true;
+
+    // the table does not cover the last cluster, so the next one exists
+    offset_type offset = getClusterOffset(idx);
+    offset_type end = getClusterOffset(idx + 1);
+    uint32_t checksum = clusterChecksums[idx];
+    lock.unlock();
+
+    std::vector<char> buffer(end - offset < 1024 * 1024 ? end - offset : 1024 * 1024);
+    return checksumRange(zimFile, offset, end, buffer) == checksum;
+  }
+
+  bool FileImpl::verifyClusters(std::vector<size_type>& corrupt, unsigned threads, VerifyProgress* progress)
+  {
+    corrupt.clear();
+
+    readClusterChecksums();
+    if (clusterChecksums.empty())
+      return false;
+
+    // read the offsets of the clusters and of the end of the last one
+    size_type count = clusterChecksums.size();
+    std::vector<offset_type> offsets(count + 1);
+    unsigned size = offsets.size() * sizeof(offset_type);
+    if (zimFile.readAt(reinterpret_cast<char*>(&offsets[0]), header.getClusterPtrPos(), size) != size)
+      throw ZimFileFormatError("error reading cluster offsets");
+
+    for (std::vector<offset_type>::iterator it = offsets.begin(); it != offsets.end(); ++it)
+      *it = fromLittleEndian(&*it);
+
+    if (threads == 0)
+    {
+      long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+      threads = n > 0 ? n : 1;
+    }
+
+    log_debug("verify " << count << " clusters in " << threads << " threads");
+
+    ClusterVerifier verifier(zimFile, clusterChecksums, offsets);
+    verifier.run(threads, progress);
+    corrupt = verifier.getCorrupt();
+
+    return true;
+  }
+
+  bool FileImpl::verify(VerifyProgress* progress)
   {
     if (!header.hasChecksum())
       return false;
 
-    Md5stream md5;
+    // The file is read in large blocks by a separate thread while the
+    // previous block is hashed. readAt does not touch the stream, so the
+    // mutex is not held and the file can be used meanwhile.
+    offset_type total = header.getChecksumPos();
+    BlockReader reader(zimFile, 0, total);
 
-    zimFile.seekg(0);
-    char ch;
-    for (offset_type n = 0; n < header.getChecksumPos() && zimFile.get(ch); ++n)
-      md5 << ch;
+    zim_MD5_CTX context;
+    zim_MD5Init(&context);
+
+    offset_type done = 0;
+    const char* data;
+    unsigned count;
+    while ((data = reader.next(count)) != 0)
+    {
+      zim_MD5Update(&context, reinterpret_cast<const unsigned char*>(data), count);
+      done += count;
+      if (progress)
+        progress->onProgress(done, total);
+    }
 
     unsigned char chksumFile[16];
     unsigned char chksumCalc[16];
 
-    zimFile.read(reinterpret_cast<char*>(chksumFile), 16);
-
-    if (!zimFile)
+    if (zimFile.readAt(reinterpret_cast<char*>(chksumFile), total, 16) != 16)
       throw ZimFileFormatError("failed to read checksum from zim file");
 
-    md5.getDigest(chksumCalc);
+    zim_MD5Final(chksumCalc, &context);
     if (std::memcmp(chksumFile, chksumCalc, 16) != 0)
       throw ZimFileFormatError("invalid checksum in zim file");
 
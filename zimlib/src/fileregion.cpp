@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <zim/fileregion.h>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "config.h"
+#include "log.h"
+
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
+log_define("zim.fileregion")
+
+namespace zim
+{
+  namespace
+  {
+    void throwError(const char* fn)
+    {
+      std::ostringstream msg;
+      msg << fn << " failed with errno " << errno << " : " << strerror(errno);
+      throw std::runtime_error(msg.str());
+    }
+  }
+
+  offset_type FileRegion::sendTo(int outFd) const
+  {
+    offset_type sent = 0;
+
+#ifdef HAVE_SYS_SENDFILE_H
+    off_t off = offset;
+    while (sent < size)
+    {
+      // limit a single call, so that the count fits into ssize_t everywhere
+      size_t count = size - sent < 0x40000000 ? size - sent : 0x40000000;
+      ssize_t n = ::sendfile(outFd, fd, &off, count);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+
+        // sendfile does not support all kinds of descriptors
+        if (sent == 0 && (errno == EINVAL || errno == ENOSYS))
+        {
+          log_debug("sendfile not supported; copy data");
+          break;
+        }
+
+        throwError("sendfile");
+      }
+
+      if (n == 0)
+        throw std::runtime_error("unexpected end of file in sendfile");
+
+      sent += n;
+    }
+
+    if (sent == size)
+      return sent;
+#endif
+
+    std::vector<char> buffer(65536);
+    while (sent < size)
+    {
+      size_t count = size - sent < buffer.size() ? size - sent : buffer.size();
+      ssize_t n = ::pread(fd, &buffer[0], count, offset + sent);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        throwError("pread");
+      }
+
+      if (n == 0)
+        throw std::runtime_error("unexpected end of file");
+
+      for (ssize_t w = 0; w < n; )
+      {
+        ssize_t ret = ::write(outFd, &buffer[w], n - w);
+        if (ret < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          throwError("write");
+        }
+        w += ret;
+      }
+
+      sent += n;
+    }
+
+    return sent;
+  }
+
+}
@@ -20,8 +20,10 @@
 #include <zim/fstream.h>
 #include "log.h"
 #include "config.h"
+#include "envvalue.h"
 #include <sstream>
 #include <stdexcept>
+#include <algorithm>
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
@@ -34,6 +36,14 @@
 #include <unistd.h>
 #endif
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#ifdef ENABLE_IO_URING
+#include "iouring.h"
+#endif
+
 #ifndef O_LARGEFILE 
 #define O_LARGEFILE 0
 #endif
@@ -74,11 +84,41 @@ streambuf::OpenfileInfo::~OpenfileInfo()
   ::close(fd);
 }
 
+////////////////////////////////////////////////////////////
+// Mapping
+//
+streambuf::Mapping::Mapping(int fd, zim::offset_type size_)
+  : address(0),
+    size(size_)
+{
+#ifdef HAVE_MMAP
+  void* p = ::mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+  {
+    std::ostringstream msg;
+    msg << "error " << errno << " mapping file: " << strerror(errno);
+    throw std::runtime_error(msg.str());
+  }
+  address = p;
+#else
+  throw std::runtime_error("mmap not supported");
+#endif
+}
+
+streambuf::Mapping::~Mapping()
+{
+#ifdef HAVE_MMAP
+  if (address)
+    ::munmap(address, size);
+#endif
+}
+
 ////////////////////////////////////////////////////////////
 // FileInfo
 //
 streambuf::FileInfo::FileInfo(const std::string& fname_, int fd)
-  : fname(fname_)
+  : fname(fname_),
+    mapFailed(false)
 {
 #if defined(_WIN32)
   __int64 ret = ::_lseeki64(fd, 0, SEEK_END);
@@ -135,6 +175,8 @@ std::streambuf::int_type streambuf::underflow()
     }
   } while (n == 0);
 
+  currentPos += n;
+
   char* p = &buffer[0];
   setg(p, p, p + n);
   return traits_type::to_int_type(*gptr());
@@ -147,6 +189,22 @@ int streambuf::sync()
 
 namespace
 {
+  ssize_t preadFd(int fd, char* buffer, size_t count, zim::offset_type off)
+  {
+#if defined(_WIN32)
+    __int64 pos = ::_lseeki64(fd, 0, SEEK_CUR);
+    if (::_lseeki64(fd, off, SEEK_SET) < 0)
+      return -1;
+    ssize_t ret = ::read(fd, buffer, count);
+    ::_lseeki64(fd, pos, SEEK_SET);
+    return ret;
+#elif defined(HAVE_LSEEK64)
+    return ::pread64(fd, buffer, count, off);
+#else
+    return ::pread(fd, buffer, count, off);
+#endif
+  }
+
   void parseFilelist(const std::string& list, std::vector<std::string>& out)
   {
     enum {
@@ -184,8 +242,11 @@ namespace
 
 streambuf::streambuf(const std::string& fname, unsigned bufsize, unsigned noOpenFiles)
   : buffer(bufsize),
+    currentPos(0),
     openFilesCache(noOpenFiles),
-    mtime(0)
+    mtime(0),
+    ring(0),
+    ringChecked(false)
 {
   log_debug("streambuf for " << fname << " with " << bufsize << " bytes");
 
@@ -228,8 +289,27 @@ streambuf::streambuf(const std::string& fname, unsigned bufsize, unsigned noOpen
   setCurrentFile((*files.begin())->fname, 0);
 }
 
+streambuf::~streambuf()
+{
+#ifdef ENABLE_IO_URING
+  delete ring;
+#endif
+}
+
+streambuf::OpenfileInfoPtr streambuf::getOpenfile(const std::string& fname)
+{
+  std::pair<bool, OpenfileInfoPtr> f = openFilesCache.getx(fname);
+  if (f.first)
+    return f.second;
+
+  OpenfileInfoPtr file = new OpenfileInfo(fname);
+  openFilesCache.put(fname, file);
+  return file;
+}
+
 void streambuf::setCurrentFile(const std::string& fname, zim::offset_type off)
 {
+  MutexLock lock(mutex);
   std::pair<bool, OpenfileInfoPtr> f = openFilesCache.getx(fname);
   if (f.first)
   {
@@ -241,6 +321,7 @@ void streambuf::setCurrentFile(const std::string& fname, zim::offset_type off)
     currentFile = new OpenfileInfo(fname);
     openFilesCache.put(fname, currentFile);
   }
+  lock.unlock();
 
   if (f.first || off != 0) // found in cache or seek requested
   {
@@ -263,6 +344,16 @@ void streambuf::setCurrentFile(const std::string& fname, zim::offset_type off)
 
 void streambuf::seekg(zim::offset_type off)
 {
+  // reuse the buffer, when the requested offset is already read
+  if (egptr() != 0
+    && off < currentPos
+    && off >= currentPos - static_cast<zim::offset_type>(egptr() - eback()))
+  {
+    log_debug("seek to " << off << " in buffer");
+    setg(eback(), egptr() - (currentPos - off), egptr());
+    return;
+  }
+
   setg(0, 0, 0);
 
   zim::offset_type o = off;
@@ -278,6 +369,7 @@ void streambuf::seekg(zim::offset_type off)
   }
 
   setCurrentFile((*it)->fname, o);
+  currentPos = off;
 }
 
 zim::offset_type streambuf::fsize() const
@@ -313,4 +405,266 @@ time_t streambuf::getMTime() const
   return mtime;
 }
 
+void streambuf::advise(zim::offset_type off, zim::offset_type count, int advice)
+{
+#ifdef HAVE_POSIX_FADVISE
+  MutexLock lock(mutex);
+  for (FilesType::iterator it = files.begin(); it != files.end() && count > 0; ++it)
+  {
+    if (off >= (*it)->fsize)
+    {
+      off -= (*it)->fsize;
+      continue;
+    }
+
+    zim::offset_type n = std::min(count, (*it)->fsize - off);
+    int ret = ::posix_fadvise(getOpenfile((*it)->fname)->fd, off, n, advice);
+    if (ret != 0)
+      log_warn("posix_fadvise failed with error " << ret << " : " << strerror(ret));
+
+    count -= n;
+    off = 0;
+  }
+#endif
+}
+
+void streambuf::prefetch(zim::offset_type off, zim::offset_type count)
+{
+#ifdef HAVE_POSIX_FADVISE
+  log_debug("prefetch " << count << " bytes at offset " << off);
+  advise(off, count, POSIX_FADV_WILLNEED);
+#endif
+}
+
+void streambuf::setAccessPattern(AccessPattern pattern)
+{
+#ifdef HAVE_POSIX_FADVISE
+  log_debug("set access pattern " << pattern);
+  int advice = pattern == accessSequential ? POSIX_FADV_SEQUENTIAL
+             : pattern == accessRandom     ? POSIX_FADV_RANDOM
+             :                               POSIX_FADV_NORMAL;
+  advise(0, fsize(), advice);
+#endif
+}
+
+IoUring* streambuf::getRing()
+{
+#ifdef ENABLE_IO_URING
+  if (!ringChecked)
+  {
+    ringChecked = true;
+    if (envValue("ZIM_IOURING", 1))
+    {
+      ring = new IoUring();
+      if (!ring->good())
+      {
+        delete ring;
+        ring = 0;
+      }
+    }
+  }
+
+  if (ring && !ring->good())
+  {
+    log_warn("io_uring failed; fall back to pread");
+    delete ring;
+    ring = 0;
+  }
+#endif
+  return ring;
+}
+
+const char* streambuf::map(zim::offset_type off, zim::offset_type count, SmartPtr<RefCounted>& owner)
+{
+  static const bool useMmap = envValue("ZIM_MMAP", 1) != 0;
+  if (!useMmap)
+    return 0;
+
+  MutexLock lock(mutex);
+
+  for (FilesType::iterator it = files.begin(); it != files.end(); ++it)
+  {
+    if (off >= (*it)->fsize)
+    {
+      off -= (*it)->fsize;
+      continue;
+    }
+
+    // ranges spanning multiple parts of a split file are not mapped
+    if (count > (*it)->fsize - off || (*it)->mapFailed)
+      return 0;
+
+    if (!(*it)->mapping)
+    {
+      // the whole file is mapped once and shared by all users
+      if (static_cast<zim::offset_type>(static_cast<size_t>((*it)->fsize)) != (*it)->fsize)
+      {
+        (*it)->mapFailed = true;
+        return 0;
+      }
+
+      try
+      {
+        (*it)->mapping = new Mapping(getOpenfile((*it)->fname)->fd, (*it)->fsize);
+        log_debug("file " << (*it)->fname << " mapped");
+      }
+      catch (const std::exception& e)
+      {
+        log_warn(e.what() << "; read file instead");
+        (*it)->mapFailed = true;
+        return 0;
+      }
+    }
+
+    owner = (*it)->mapping.getPointer();
+    return static_cast<const char*>((*it)->mapping->address) + off;
+  }
+
+  return 0;
+}
+
+FileRegion streambuf::getFileRegion(zim::offset_type off, zim::offset_type count)
+{
+  MutexLock lock(mutex);
+
+  for (FilesType::iterator it = files.begin(); it != files.end(); ++it)
+  {
+    if (off >= (*it)->fsize)
+    {
+      off -= (*it)->fsize;
+      continue;
+    }
+
+    if (count > (*it)->fsize - off)
+      break;
+
+    OpenfileInfoPtr file = getOpenfile((*it)->fname);
+    return FileRegion(file.getPointer(), file->fd, off, count);
+  }
+
+  return FileRegion();
+}
+
+unsigned streambuf::readAt(char* buffer, zim::offset_type off, unsigned count)
+{
+  ReadRequests requests(1, ReadRequest(off, buffer, count));
+  readBatch(requests);
+  return requests[0].count;
+}
+
+void streambuf::readBatch(ReadRequests& requests)
+{
+  // Split the requests into reads of the single files. The file infos are
+  // kept here, so that the descriptors are not closed while reading, when
+  // the open files cache is smaller than the number of files.
+  struct Segment
+  {
+    OpenfileInfoPtr file;
+    zim::offset_type offset;
+    char* buffer;
+    unsigned size;
+    unsigned request;
+  };
+
+  std::vector<Segment> segments;
+  MutexLock lock(mutex);
+  for (unsigned r = 0; r < requests.size(); ++r)
+  {
+    ReadRequest& request = requests[r];
+    request.count = 0;
+
+    zim::offset_type off = request.offset;
+    char* buffer = request.buffer;
+    unsigned size = request.size;
+    for (FilesType::iterator it = files.begin(); it != files.end() && size > 0; ++it)
+    {
+      if (off >= (*it)->fsize)
+      {
+        off -= (*it)->fsize;
+        continue;
+      }
+
+      Segment segment;
+      segment.file = getOpenfile((*it)->fname);
+      segment.offset = off;
+      segment.buffer = buffer;
+      segment.size = static_cast<unsigned>(std::min(static_cast<zim::offset_type>(size), (*it)->fsize - off));
+      segment.request = r;
+      segments.push_back(segment);
+
+      buffer += segment.size;
+      size -= segment.size;
+      off = 0;
+    }
+  }
+
+  lock.unlock();
+
+  if (segments.empty())
+    return;
+
+  std::vector<ssize_t> results(segments.size(), 0);
+
+#ifdef ENABLE_IO_URING
+  if (segments.size() > 1)
+    lock.lock();
+  IoUring* r = segments.size() > 1 ? getRing() : 0;
+  if (r)
+  {
+    std::vector<IoUring::Read> reads(segments.size());
+    for (unsigned n = 0; n < segments.size(); ++n)
+    {
+      reads[n].fd = segments[n].file->fd;
+      reads[n].offset = segments[n].offset;
+      reads[n].buffer = segments[n].buffer;
+      reads[n].size = segments[n].size;
+      reads[n].result = 0;
+    }
+
+    log_debug("read " << reads.size() << " segments using io_uring");
+    if (r->read(&reads[0], reads.size()))
+    {
+      for (unsigned n = 0; n < reads.size(); ++n)
+        results[n] = reads[n].result;
+    }
+    else
+      r = 0;
+  }
+  lock.unlock();
+
+  if (!r)
+#endif
+  {
+    log_debug("read " << segments.size() << " segments using pread");
+    for (unsigned n = 0; n < segments.size(); ++n)
+    {
+      const Segment& segment = segments[n];
+      while (results[n] >= 0 && static_cast<unsigned>(results[n]) < segment.size)
+      {
+        ssize_t ret = preadFd(segment.file->fd, segment.buffer + results[n],
+                              segment.size - results[n], segment.offset + results[n]);
+        if (ret < 0 && errno == EINTR)
+          continue;
+        if (ret < 0)
+          results[n] = -errno;
+        if (ret <= 0)
+          break;
+        results[n] += ret;
+      }
+    }
+  }
+
+  for (unsigned n = 0; n < segments.size(); ++n)
+  {
+    if (results[n] < 0)
+    {
+      std::ostringstream msg;
+      msg << "error " << -results[n] << " reading from file " << segments[n].file->fname << ": " << strerror(-results[n]);
+      throw std::runtime_error(msg.str());
+    }
+
+    requests[segments[n].request].count += results[n];
+  }
+}
+
 }
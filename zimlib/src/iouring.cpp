@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include "iouring.h"
+#include "log.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+log_define("zim.iouring")
+
+namespace zim
+{
+  namespace
+  {
+    int io_uring_setup(unsigned entries, struct io_uring_params* p)
+    {
+      return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+    }
+
+    int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+      return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, 0, 0));
+    }
+
+    unsigned loadAcquire(const unsigned* p)
+    {
+      return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+
+    void storeRelease(unsigned* p, unsigned v)
+    {
+      __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+
+    template <typename T>
+    T* at(void* base, unsigned off)
+    {
+      return reinterpret_cast<T*>(static_cast<char*>(base) + off);
+    }
+  }
+
+  IoUring::IoUring(unsigned entries_)
+    : ringFd(-1),
+      entries(0),
+      sqRing(MAP_FAILED),
+      sqRingSize(0),
+      cqRing(MAP_FAILED),
+      cqRingSize(0),
+      sqesPtr(MAP_FAILED),
+      sqesSize(0)
+  {
+    struct io_uring_params p;
+    ::memset(&p, 0, sizeof(p));
+
+    ringFd = io_uring_setup(entries_, &p);
+    if (ringFd < 0)
+    {
+      log_info("io_uring not available; errno " << errno << " : " << strerror(errno));
+      return;
+    }
+
+    entries = p.sq_entries;
+
+    sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    bool singleMmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+    {
+      if (cqRingSize > sqRingSize)
+        sqRingSize = cqRingSize;
+      cqRingSize = sqRingSize;
+    }
+
+    sqRing = ::mmap(0, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+      log_warn("failed to map io_uring submission queue; errno " << errno);
+      release();
+      return;
+    }
+
+    if (singleMmap)
+      cqRing = sqRing;
+    else
+    {
+      cqRing = ::mmap(0, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd, IORING_OFF_CQ_RING);
+      if (cqRing == MAP_FAILED)
+      {
+        log_warn("failed to map io_uring completion queue; errno " << errno);
+        release();
+        return;
+      }
+    }
+
+    sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqesPtr = ::mmap(0, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ringFd, IORING_OFF_SQES);
+    if (sqesPtr == MAP_FAILED)
+    {
+      log_warn("failed to map io_uring submission entries; errno " << errno);
+      release();
+      return;
+    }
+
+    sqHead = at<unsigned>(sqRing, p.sq_off.head);
+    sqTail = at<unsigned>(sqRing, p.sq_off.tail);
+    sqMask = at<unsigned>(sqRing, p.sq_off.ring_mask);
+    sqArray = at<unsigned>(sqRing, p.sq_off.array);
+    cqHead = at<unsigned>(cqRing, p.cq_off.head);
+    cqTail = at<unsigned>(cqRing, p.cq_off.tail);
+    cqMask = at<unsigned>(cqRing, p.cq_off.ring_mask);
+    cqes = at<void>(cqRing, p.cq_off.cqes);
+
+    iovecs.resize(entries);
+
+    log_debug("io_uring with " << entries << " entries created");
+  }
+
+  IoUring::~IoUring()
+  {
+    release();
+  }
+
+  void IoUring::release()
+  {
+    if (sqesPtr != MAP_FAILED)
+      ::munmap(sqesPtr, sqesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+      ::munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+      ::munmap(sqRing, sqRingSize);
+    if (ringFd >= 0)
+      ::close(ringFd);
+
+    sqesPtr = cqRing = sqRing = MAP_FAILED;
+    ringFd = -1;
+  }
+
+  unsigned IoUring::submitAndWait(Read* reads, unsigned count)
+  {
+    struct io_uring_sqe* sqes = static_cast<struct io_uring_sqe*>(sqesPtr);
+
+    unsigned start = *sqTail;
+    unsigned tail = start;
+    for (unsigned n = 0; n < count; ++n)
+    {
+      unsigned index = tail & *sqMask;
+      struct io_uring_sqe* sqe = &sqes[index];
+      ::memset(sqe, 0, sizeof(*sqe));
+
+      // IORING_OP_READV is available since the first io_uring kernel
+      iovecs[n].iov_base = reads[n].buffer;
+      iovecs[n].iov_len = reads[n].size;
+      sqe->opcode = IORING_OP_READV;
+      sqe->fd = reads[n].fd;
+      sqe->off = reads[n].offset;
+      sqe->addr = reinterpret_cast<unsigned long>(&iovecs[n]);
+      sqe->len = 1;
+      sqe->user_data = n;
+
+      sqArray[index] = index;
+      ++tail;
+    }
+    storeRelease(sqTail, tail);
+
+    unsigned completed = 0;
+    while (completed < count)
+    {
+      int ret = io_uring_enter(ringFd, count - completed, count - completed, IORING_ENTER_GETEVENTS);
+      if (ret < 0 && errno != EINTR)
+      {
+        log_warn("io_uring_enter failed; errno " << errno << " : " << strerror(errno));
+
+        // Reads, which the kernel has already taken from the submission
+        // queue, may still write into the buffers. They are waited for, so
+        // that the caller can reuse the buffers, when the ring is released.
+        unsigned submitted = loadAcquire(sqHead) - start;
+        completed += reap(reads);
+        while (completed < submitted)
+        {
+          if (io_uring_enter(ringFd, 0, submitted - completed, IORING_ENTER_GETEVENTS) < 0
+            && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+          {
+            log_error("failed to wait for " << submitted - completed << " pending reads; errno " << errno << " : " << strerror(errno));
+            break;
+          }
+          completed += reap(reads);
+        }
+
+        return completed;
+      }
+
+      completed += reap(reads);
+    }
+
+    return completed;
+  }
+
+  // Stores the results of the completed reads and returns their number.
+  unsigned IoUring::reap(Read* reads)
+  {
+    unsigned count = 0;
+    unsigned head = *cqHead;
+    while (head != loadAcquire(cqTail))
+    {
+      const struct io_uring_cqe* cqe = static_cast<const struct io_uring_cqe*>(cqes) + (head & *cqMask);
+      reads[cqe->user_data].result = cqe->res;
+      ++head;
+      ++count;
+    }
+    storeRelease(cqHead, head);
+    return count;
+  }
+
+  bool IoUring::read(Read* reads, unsigned count)
+  {
+    if (!good())
+      return false;
+
+    log_debug("submit " << count << " reads");
+
+    while (count > 0)
+    {
+      unsigned n = count < entries ? count : entries;
+      if (submitAndWait(reads, n) < n)
+      {
+        // the ring is in an undefined state; do not use it any more
+        release();
+        return false;
+      }
+
+      // complete short reads, which may happen e.g. on signals
+      for (unsigned i = 0; i < n; ++i)
+      {
+        Read& r = reads[i];
+        while (r.result >= 0 && static_cast<size_t>(r.result) < r.size)
+        {
+          ssize_t ret = ::pread(r.fd, r.buffer + r.result, r.size - r.result, r.offset + r.result);
+          if (ret < 0 && errno == EINTR)
+            continue;
+          if (ret <= 0)
+            break;
+          r.result += ret;
+        }
+      }
+
+      reads += n;
+      count -= n;
+    }
+
+    return true;
+  }
+
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef ZIM_IOURING_H
+#define ZIM_IOURING_H
+
+#include <zim/noncopyable.h>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace zim
+{
+  /**
+   Minimal io_uring ring for submitting many independent reads with a single
+   system call.
+
+   The ring is used without liburing. When the kernel does not support
+   io_uring (or it is disabled e.g. by seccomp), good() returns false and the
+   caller has to fall back to pread.
+   */
+  class IoUring : private NonCopyable
+  {
+    public:
+      struct Read
+      {
+        int fd;
+        off_t offset;
+        char* buffer;
+        size_t size;
+        ssize_t result;   // number of bytes read or -errno
+      };
+
+    private:
+      int ringFd;
+      unsigned entries;
+
+      void* sqRing;
+      size_t sqRingSize;
+      void* cqRing;
+      size_t cqRingSize;
+      void* sqesPtr;
+      size_t sqesSize;
+
+      unsigned* sqHead;
+      unsigned* sqTail;
+      unsigned* sqMask;
+      unsigned* sqArray;
+      unsigned* cqHead;
+      unsigned* cqTail;
+      unsigned* cqMask;
+      void* cqes;
+
+      std::vector<struct iovec> iovecs;
+
+      void release();
+      unsigned submitAndWait(Read* reads, unsigned count);
+      unsigned reap(Read* reads);
+
+    public:
+      explicit IoUring(unsigned entries = 64);
+      ~IoUring();
+
+      bool good() const   { return ringFd >= 0; }
+
+      // Executes all reads and waits for their completion. The results are
+      // stored in Read::result. Returns false, when the ring failed and the
+      // reads have to be done using another method.
+      bool read(Read* reads, unsigned count);
+  };
+}
+
+#endif // ZIM_IOURING_H
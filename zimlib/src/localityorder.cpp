@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "localityorder.h"
+#include "articlequeue.h"
+#include <zim/file.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string.h>
+#include "log.h"
+
+log_define("zim.writer.locality")
+
+namespace zim
+{
+  namespace writer
+  {
+    namespace
+    {
+      std::string longUrl(const Article& article)
+      {
+        return std::string(1, article.getNamespace()) + '/' + article.getUrl();
+      }
+    }
+
+    std::string LocalityOrder::resolveLink(const std::string& pageUrl, std::string link)
+    {
+      std::string::size_type e = link.find_first_of("?#");
+      if (e != std::string::npos)
+        link.erase(e);
+
+      if (link.empty() || link.compare(0, 2, "//") == 0)
+        return std::string();
+
+      std::string::size_type colon = link.find(':');
+      if (colon != std::string::npos && link.find('/') > colon)
+        return std::string();  // has a scheme like http: or mailto:
+
+      std::string path;
+      if (link[0] == '/')
+        path = link.substr(1);
+      else
+      {
+        std::string::size_type s = pageUrl.rfind('/');
+        path = (s == std::string::npos ? std::string() : pageUrl.substr(0, s + 1)) + link;
+      }
+
+      // remove . and .. segments
+      std::vector<std::string> segments;
+      std::string::size_type b = 0;
+      while (b <= path.size())
+      {
+        std::string::size_type s = path.find('/', b);
+        if (s == std::string::npos)
+          s = path.size();
+        std::string segment = path.substr(b, s - b);
+        if (segment == "..")
+        {
+          if (!segments.empty())
+            segments.pop_back();
+        }
+        else if (segment != "." && !segment.empty())
+          segments.push_back(segment);
+        b = s + 1;
+      }
+
+      std::string ret;
+      for (std::vector<std::string>::const_iterator it = segments.begin(); it != segments.end(); ++it)
+      {
+        if (!ret.empty())
+          ret += '/';
+        ret += *it;
+      }
+
+      return urldecode(ret);
+    }
+
+    void LocalityOrder::extractLinks(const std::string& pageUrl, const char* data, size_type size,
+                                     std::vector<std::string>& links)
+    {
+      static const char* const attributes[] = { "href=", "src=" };
+
+      const char* end = data + size;
+      for (unsigned a = 0; a < sizeof(attributes) / sizeof(attributes[0]); ++a)
+      {
+        const char* attr = attributes[a];
+        const char* attrEnd = attr + strlen(attr);
+        const char* p = data;
+        while ((p = std::search(p, end, attr, attrEnd)) != end)
+        {
+          p += attrEnd - attr;
+          if (p == end || (*p != '"' && *p != '\''))
+            continue;
+
+          char quote = *p++;
+          const char* v = std::find(p, end, quote);
+          if (v == end)
+            break;
+
+          std::string link = resolveLink(pageUrl, std::string(p, v));
+          if (!link.empty())
+            links.push_back(link);
+          p = v + 1;
+        }
+      }
+    }
+
+    LocalityOrder::LocalityOrder(ArticleSource& src_, size_type maxAssetSize_,
+                                 unsigned maxArticles_, offset_type maxBytes_)
+      : src(src_),
+        maxArticles(maxArticles_ > 0 ? maxArticles_ : 1),
+        maxBytes(maxBytes_),
+        maxAssetSize(maxAssetSize_),
+        next(0),
+        eof(false)
+    {
+    }
+
+    LocalityOrder::~LocalityOrder()
+    {
+      clear();
+    }
+
+    void LocalityOrder::clear()
+    {
+      for (Articles::iterator it = window.begin(); it != window.end(); ++it)
+        delete *it;
+      window.clear();
+      next = 0;
+    }
+
+    const Article* LocalityOrder::getNextArticle()
+    {
+      if (next >= window.size())
+      {
+        clear();
+        fill();
+        if (window.empty())
+          return 0;
+      }
+
+      return window[next++];
+    }
+
+    void LocalityOrder::fill()
+    {
+      // read the window
+      Articles articles;
+      std::vector<std::vector<std::string> > links;
+      offset_type bytes = 0;
+      while (!eof && articles.size() < maxArticles && bytes < maxBytes)
+      {
+        const Article* article = src.getNextArticle();
+        if (article == 0)
+        {
+          eof = true;
+          break;
+        }
+
+        QueuedArticle* a = new QueuedArticle(*article);
+        articles.push_back(a);
+        bytes += a->getMemorySize();
+
+        links.push_back(a->getLinks());
+        if (links.back().empty() && !a->isRedirect() && a->getMimeType() == "text/html")
+        {
+          Blob data = a->getData();
+          extractLinks(longUrl(*a), data.data(), data.size(), links.back());
+        }
+      }
+
+      if (articles.empty())
+        return;
+
+      // resolve the links to positions in the window
+      typedef std::vector<Articles::size_type> Positions;
+      std::map<std::string, Articles::size_type> positions;
+      for (Articles::size_type n = 0; n < articles.size(); ++n)
+        positions.insert(std::make_pair(longUrl(*articles[n]), n));
+
+      std::vector<Positions> targets(articles.size());
+      std::vector<unsigned> refs(articles.size());
+      std::vector<bool> isPage(articles.size());
+      for (Articles::size_type n = 0; n < articles.size(); ++n)
+      {
+        Positions& t = targets[n];
+        for (std::vector<std::string>::const_iterator it = links[n].begin(); it != links[n].end(); ++it)
+        {
+          std::map<std::string, Articles::size_type>::const_iterator p = positions.find(*it);
+          if (p != positions.end() && p->second != n)
+            t.push_back(p->second);
+        }
+
+        std::sort(t.begin(), t.end());
+        t.erase(std::unique(t.begin(), t.end()), t.end());
+        isPage[n] = !t.empty();
+        for (Positions::const_iterator it = t.begin(); it != t.end(); ++it)
+          ++refs[*it];
+      }
+
+      // Small articles referenced by a single page are assets of that page.
+      std::vector<bool> isAsset(articles.size());
+      for (Articles::size_type n = 0; n < articles.size(); ++n)
+        isAsset[n] = !isPage[n] && refs[n] == 1 && articles[n]->getDataSize() <= maxAssetSize;
+
+      // Starting at each page in the original order, the pages reachable
+      // by links are visited breadth first. Each page is followed by its
+      // assets.
+      std::vector<bool> placed(articles.size());
+      window.reserve(articles.size());
+      for (Articles::size_type n = 0; n < articles.size(); ++n)
+      {
+        if (placed[n] || isAsset[n])
+          continue;
+
+        std::deque<Articles::size_type> queue;
+        queue.push_back(n);
+        placed[n] = true;
+
+        while (!queue.empty())
+        {
+          Articles::size_type p = queue.front();
+          queue.pop_front();
+          window.push_back(articles[p]);
+
+          for (Positions::const_iterator it = targets[p].begin(); it != targets[p].end(); ++it)
+          {
+            if (!placed[*it] && isAsset[*it])
+            {
+              placed[*it] = true;
+              window.push_back(articles[*it]);
+            }
+          }
+
+          for (Positions::const_iterator it = targets[p].begin(); it != targets[p].end(); ++it)
+          {
+            if (!placed[*it] && isPage[*it])
+            {
+              placed[*it] = true;
+              queue.push_back(*it);
+            }
+          }
+        }
+      }
+
+      log_debug("window of " << articles.size() << " articles reordered");
+    }
+
+  }
+}
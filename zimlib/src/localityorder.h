@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_WRITER_LOCALITYORDER_H
+#define ZIM_WRITER_LOCALITYORDER_H
+
+#include <zim/writer/articlesource.h>
+#include <zim/noncopyable.h>
+#include <string>
+#include <vector>
+
+namespace zim
+{
+  namespace writer
+  {
+    class QueuedArticle;
+
+    /**
+     Article source, which reorders the articles of another source, so that
+     articles viewed together are stored next to each other.
+
+     The articles are read in windows. Within a window an html page is
+     followed by the small assets, which are referenced only by this page,
+     and then by the pages it links to. The order of the other articles is
+     kept.
+     */
+    class LocalityOrder : public ArticleSource, private NonCopyable
+    {
+        typedef std::vector<QueuedArticle*> Articles;
+
+        ArticleSource& src;
+        unsigned maxArticles;
+        offset_type maxBytes;
+        size_type maxAssetSize;
+        Articles window;         // in the new order
+        Articles::size_type next;
+        bool eof;
+
+        void clear();
+        void fill();
+
+      public:
+        LocalityOrder(ArticleSource& src, size_type maxAssetSize,
+                      unsigned maxArticles = 4096, offset_type maxBytes = 64 * 1024 * 1024);
+        ~LocalityOrder();
+
+        virtual void setFilename(const std::string& fname)  { src.setFilename(fname); }
+        virtual const Article* getNextArticle();
+        virtual Uuid getUuid()                { return src.getUuid(); }
+        virtual std::string getMainPage()     { return src.getMainPage(); }
+        virtual std::string getLayoutPage()   { return src.getLayoutPage(); }
+        virtual Category* getCategory(const std::string& cid)
+          { return src.getCategory(cid); }
+
+        // Resolves a link relative to the url of the page (with namespace)
+        // and urldecodes it. Returns an empty string for external links.
+        static std::string resolveLink(const std::string& pageUrl, std::string link);
+
+        // Appends the local links found in src and href attributes of the
+        // html data to links. The links are resolved relative to the url of
+        // the page (with namespace).
+        static void extractLinks(const std::string& pageUrl, const char* data, size_type size,
+                                 std::vector<std::string>& links);
+    };
+
+  }
+}
+
+#endif // ZIM_WRITER_LOCALITYORDER_H
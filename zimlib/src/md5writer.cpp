@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "md5writer.h"
+#include "md5.h"
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+
+namespace zim
+{
+  Md5Writerbuf::Md5Writerbuf(std::streambuf* target_)
+    : target(target_),
+      context(new zim_MD5_CTX()),
+      written(0),
+      hashing(false),
+      stop(false)
+  {
+    zim_MD5Init(context);
+
+    for (unsigned n = 0; n < blockCount; ++n)
+    {
+      Block* block = new Block();
+      block->data.resize(blockSize);
+      block->size = 0;
+      blocks.push_back(block);
+      freeBlocks.push_back(block);
+    }
+
+    current = freeBlocks.front();
+    freeBlocks.pop_front();
+    setp(&current->data[0], &current->data[0] + blockSize);
+
+    int ret = ::pthread_create(&thread, 0, threadStart, this);
+    if (ret != 0)
+    {
+      for (std::vector<Block*>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+        delete *it;
+      delete context;
+
+      std::ostringstream msg;
+      msg << "failed to create thread; error " << ret << " : " << strerror(ret);
+      throw std::runtime_error(msg.str());
+    }
+  }
+
+  Md5Writerbuf::~Md5Writerbuf()
+  {
+    MutexLock lock(mutex);
+    stop = true;
+    blockReady.signal();
+    lock.unlock();
+
+    ::pthread_join(thread, 0);
+
+    for (std::vector<Block*>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+      delete *it;
+    delete context;
+  }
+
+  void* Md5Writerbuf::threadStart(void* arg)
+  {
+    static_cast<Md5Writerbuf*>(arg)->hashBlocks();
+    return 0;
+  }
+
+  void Md5Writerbuf::hashBlocks()
+  {
+    MutexLock lock(mutex);
+
+    while (true)
+    {
+      while (hashQueue.empty() && !stop)
+        blockReady.wait(mutex);
+
+      if (hashQueue.empty())
+        break;
+
+      Block* block = hashQueue.front();
+      hashQueue.pop_front();
+      hashing = true;
+
+      lock.unlock();
+      zim_MD5Update(context, reinterpret_cast<const unsigned char*>(&block->data[0]), block->size);
+      lock.lock();
+
+      hashing = false;
+      freeBlocks.push_back(block);
+      blockHashed.broadcast();
+    }
+  }
+
+  // Writes the current block and passes it to the hash thread. Returns
+  // false, when writing fails.
+  bool Md5Writerbuf::writeBlock()
+  {
+    std::size_t size = pptr() - pbase();
+    if (size == 0)
+      return true;
+
+    if (target && target->sputn(pbase(), size) != static_cast<std::streamsize>(size))
+      return false;
+
+    written += size;
+    current->size = size;
+
+    MutexLock lock(mutex);
+    hashQueue.push_back(current);
+    blockReady.signal();
+
+    while (freeBlocks.empty())
+      blockHashed.wait(mutex);
+
+    current = freeBlocks.front();
+    freeBlocks.pop_front();
+    lock.unlock();
+
+    setp(&current->data[0], &current->data[0] + blockSize);
+    return true;
+  }
+
+  std::streambuf::int_type Md5Writerbuf::overflow(int_type ch)
+  {
+    if (!writeBlock())
+      return traits_type::eof();
+
+    if (ch != traits_type::eof())
+    {
+      *pptr() = traits_type::to_char_type(ch);
+      pbump(1);
+    }
+
+    return 0;
+  }
+
+  std::streamsize Md5Writerbuf::xsputn(const char* s, std::streamsize n)
+  {
+    std::streamsize ret = 0;
+    while (ret < n)
+    {
+      if (pptr() == epptr() && !writeBlock())
+        break;
+
+      std::streamsize count = std::min<std::streamsize>(epptr() - pptr(), n - ret);
+      std::memcpy(pptr(), s + ret, count);
+      pbump(count);
+      ret += count;
+    }
+
+    return ret;
+  }
+
+  int Md5Writerbuf::sync()
+  {
+    if (!writeBlock())
+      return -1;
+    return target ? target->pubsync() : 0;
+  }
+
+  std::streambuf::pos_type Md5Writerbuf::seekoff(off_type off, std::ios::seekdir dir, std::ios::openmode which)
+  {
+    // only reporting the current position is supported
+    if (off != 0 || dir != std::ios::cur || !(which & std::ios::out))
+      return pos_type(off_type(-1));
+    return pos_type(off_type(written + (pptr() - pbase())));
+  }
+
+  void Md5Writerbuf::getDigest(unsigned char digest[16])
+  {
+    writeBlock();
+
+    MutexLock lock(mutex);
+    while (!hashQueue.empty() || hashing)
+      blockHashed.wait(mutex);
+
+    zim_MD5Final(digest, context);
+    zim_MD5Init(context);
+  }
+
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_MD5WRITER_H
+#define ZIM_MD5WRITER_H
+
+#include <zim/zim.h>
+#include <zim/mutex.h>
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+struct zim_MD5_CTX;
+
+namespace zim
+{
+  /**
+   Stream buffer, which writes data in large blocks to another stream
+   buffer and calculates the MD5 sum of the data.
+
+   The sum is calculated in a separate thread, while the next block is
+   filled and written. Without a target the data is just hashed.
+   */
+  class Md5Writerbuf : public std::streambuf
+  {
+      struct Block
+      {
+        std::vector<char> data;
+        std::size_t size;
+      };
+
+      typedef std::deque<Block*> Blocks;
+
+      static const std::size_t blockSize = 1024 * 1024;
+      static const unsigned blockCount = 4;
+
+      std::streambuf* target;
+      zim_MD5_CTX* context;
+      offset_type written;
+
+      Mutex mutex;
+      Condition blockHashed;
+      Condition blockReady;
+      Blocks hashQueue;
+      Blocks freeBlocks;
+      Block* current;
+      std::vector<Block*> blocks;
+      pthread_t thread;
+      bool hashing;
+      bool stop;
+
+      static void* threadStart(void* arg);
+      void hashBlocks();
+      bool writeBlock();
+
+      int_type overflow(int_type ch);
+      std::streamsize xsputn(const char* s, std::streamsize n);
+      int sync();
+      pos_type seekoff(off_type off, std::ios::seekdir dir, std::ios::openmode which);
+
+    public:
+      explicit Md5Writerbuf(std::streambuf* target);
+      ~Md5Writerbuf();
+
+      // Writes the pending data and returns the MD5 sum of all data.
+      void getDigest(unsigned char digest[16]);
+  };
+
+  class Md5Writer : public std::ostream
+  {
+      Md5Writerbuf streambuf;
+
+    public:
+      Md5Writer()
+        : std::ostream(0),
+          streambuf(0)
+      {
+        init(&streambuf);
+      }
+
+      explicit Md5Writer(std::ostream& target)
+        : std::ostream(0),
+          streambuf(target.rdbuf())
+      {
+        init(&streambuf);
+      }
+
+      // Writes the pending data and returns the MD5 sum of all data.
+      void getDigest(unsigned char digest[16])
+        { streambuf.getDigest(digest); }
+  };
+
+}
+
+#endif // ZIM_MD5WRITER_H
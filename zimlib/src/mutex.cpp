@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <zim/mutex.h>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+
+namespace zim
+{
+  namespace
+  {
+    void checkError(int ret, const char* fn)
+    {
+      if (ret != 0)
+      {
+        std::ostringstream msg;
+        msg << fn << " failed with error " << ret << " : " << strerror(ret);
+        throw std::runtime_error(msg.str());
+      }
+    }
+  }
+
+  ////////////////////////////////////////////////////////////
+  // Mutex
+  //
+  Mutex::Mutex(bool recursive)
+  {
+    pthread_mutexattr_t attr;
+    checkError(::pthread_mutexattr_init(&attr), "pthread_mutexattr_init");
+    if (recursive)
+      ::pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    int ret = ::pthread_mutex_init(&mutex, &attr);
+    ::pthread_mutexattr_destroy(&attr);
+    checkError(ret, "pthread_mutex_init");
+  }
+
+  Mutex::~Mutex()
+  {
+    ::pthread_mutex_destroy(&mutex);
+  }
+
+  void Mutex::lock()
+  {
+    checkError(::pthread_mutex_lock(&mutex), "pthread_mutex_lock");
+  }
+
+  void Mutex::unlock()
+  {
+    ::pthread_mutex_unlock(&mutex);
+  }
+
+  ////////////////////////////////////////////////////////////
+  // Condition
+  //
+  Condition::Condition()
+  {
+    checkError(::pthread_cond_init(&cond, 0), "pthread_cond_init");
+  }
+
+  Condition::~Condition()
+  {
+    ::pthread_cond_destroy(&cond);
+  }
+
+  void Condition::wait(Mutex& mutex)
+  {
+    checkError(::pthread_cond_wait(&cond, &mutex.mutex), "pthread_cond_wait");
+  }
+
+  void Condition::signal()
+  {
+    ::pthread_cond_signal(&cond);
+  }
+
+  void Condition::broadcast()
+  {
+    ::pthread_cond_broadcast(&cond);
+  }
+
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_PARALLELSORT_H
+#define ZIM_PARALLELSORT_H
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include <pthread.h>
+
+namespace zim
+{
+  template <typename Iterator, typename Compare>
+  class ParallelSort
+  {
+      struct Job
+      {
+        Iterator begin;
+        Iterator middle;
+        Iterator end;
+        Compare compare;
+        pthread_t thread;
+        bool started;
+      };
+
+      static void* sortJob(void* arg)
+      {
+        Job* job = static_cast<Job*>(arg);
+        std::sort(job->begin, job->end, job->compare);
+        return 0;
+      }
+
+      static void* mergeJob(void* arg)
+      {
+        Job* job = static_cast<Job*>(arg);
+        std::inplace_merge(job->begin, job->middle, job->end, job->compare);
+        return 0;
+      }
+
+      // Runs the jobs in threads. Jobs, for which no thread can be
+      // started, are run by the caller.
+      static void run(std::vector<Job>& jobs, void* (*fn)(void*))
+      {
+        for (typename std::vector<Job>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+          it->started = ::pthread_create(&it->thread, 0, fn, &*it) == 0;
+
+        for (typename std::vector<Job>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+        {
+          if (it->started)
+            ::pthread_join(it->thread, 0);
+          else
+            fn(&*it);
+        }
+      }
+
+    public:
+      static void sort(Iterator begin, Iterator end, Compare compare, unsigned threads)
+      {
+        typedef typename std::iterator_traits<Iterator>::difference_type difference_type;
+
+        difference_type size = end - begin;
+        unsigned parts = 1;
+        while (parts * 2 <= threads && size / (parts * 2) >= 16384)
+          parts *= 2;
+
+        if (parts == 1)
+        {
+          std::sort(begin, end, compare);
+          return;
+        }
+
+        // sort the parts in parallel
+        std::vector<Iterator> bounds;
+        for (unsigned n = 0; n < parts; ++n)
+          bounds.push_back(begin + size * n / parts);
+        bounds.push_back(end);
+
+        std::vector<Job> jobs(parts);
+        for (unsigned n = 0; n < parts; ++n)
+        {
+          jobs[n].begin = bounds[n];
+          jobs[n].end = bounds[n + 1];
+          jobs[n].compare = compare;
+        }
+        run(jobs, sortJob);
+
+        // merge neighbouring parts until one is left
+        for (unsigned step = 1; step < parts; step *= 2)
+        {
+          jobs.resize(parts / (step * 2));
+          for (unsigned n = 0; n < jobs.size(); ++n)
+          {
+            jobs[n].begin = bounds[n * step * 2];
+            jobs[n].middle = bounds[n * step * 2 + step];
+            jobs[n].end = bounds[n * step * 2 + step * 2];
+            jobs[n].compare = compare;
+          }
+          run(jobs, mergeJob);
+        }
+      }
+  };
+
+  // Sorts the range like std::sort using up to the given number of threads.
+  // Small ranges are sorted by the calling thread.
+  template <typename Iterator, typename Compare>
+  void parallelSort(Iterator begin, Iterator end, Compare compare, unsigned threads)
+  {
+    ParallelSort<Iterator, Compare>::sort(begin, end, compare, threads);
+  }
+
+}
+
+#endif // ZIM_PARALLELSORT_H
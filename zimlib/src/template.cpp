@@ -132,6 +132,75 @@ namespace zim
     }
   }
 
+  class CompiledTemplate::Compiler : public TemplateParser::Event
+  {
+      CompiledTemplate& tmpl;
+
+      void add(OpType type, const std::string& s, char ns = '\0');
+
+    public:
+      explicit Compiler(CompiledTemplate& tmpl_)
+        : tmpl(tmpl_)
+        { }
+
+      void onData(const std::string& data);
+      void onToken(const std::string& token);
+      void onLink(char ns, const std::string& url);
+  };
+
+  void CompiledTemplate::Compiler::add(OpType type, const std::string& s, char ns)
+  {
+    // consecutive literal text is merged into one operation
+    if (type == opData && !tmpl.ops.empty() && tmpl.ops.back().type == opData)
+    {
+      tmpl.text += s;
+      tmpl.ops.back().size += s.size();
+      return;
+    }
+
+    Op op;
+    op.type = type;
+    op.offset = tmpl.text.size();
+    op.size = s.size();
+    op.ns = ns;
+    tmpl.text += s;
+    tmpl.ops.push_back(op);
+  }
+
+  void CompiledTemplate::Compiler::onData(const std::string& data)
+  {
+    if (!data.empty())
+      add(opData, data);
+  }
+
+  void CompiledTemplate::Compiler::onToken(const std::string& token)
+  {
+    if (token == "title")
+      add(opTitle, std::string());
+    else if (token == "url")
+      add(opUrl, std::string());
+    else if (token == "namespace")
+      add(opNamespace, std::string());
+    else if (token == "content")
+      add(opContent, std::string());
+    else
+      add(opToken, token);
+  }
+
+  void CompiledTemplate::Compiler::onLink(char ns, const std::string& url)
+  {
+    add(opLink, url, ns);
+  }
+
+  CompiledTemplate::CompiledTemplate(const char* data, unsigned size)
+  {
+    Compiler compiler(*this);
+    TemplateParser parser(&compiler);
+    for (const char* p = data; p != data + size; ++p)
+      parser.parse(*p);
+    parser.flush();
+  }
+
   void TemplateParser::flush()
   {
     if (event)
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef ZIM_WRITER_TITLEKEY_H
+#define ZIM_WRITER_TITLEKEY_H
+
+#include <zim/writer/dirent.h>
+#include <zim/zim.h>
+#include <string>
+#include <vector>
+
+namespace zim
+{
+  namespace writer
+  {
+    // Sort key of the title index. The key holds the namespace and the
+    // first 7 bytes of the title, so that most comparisons do not touch
+    // the strings. Only when the prefixes are equal, the full titles of
+    // the entries are compared.
+    struct TitleKey
+    {
+      uint64_t prefix;
+      size_type idx;
+
+      TitleKey()
+        : prefix(0),
+          idx(0)
+        { }
+
+      TitleKey(const Dirent& dirent, size_type idx_)
+        : prefix(0),
+          idx(idx_)
+      {
+        // flip the sign bit, so that namespaces are ordered like chars
+        prefix = static_cast<unsigned char>(dirent.getNamespace() ^ 0x80);
+        const std::string& title = dirent.getTitle();
+        for (unsigned n = 0; n < 7; ++n)
+          prefix = (prefix << 8) | (n < title.size() ? static_cast<unsigned char>(title[n]) : 0);
+      }
+    };
+
+    // Orders title keys by namespace and title and equal titles by index.
+    // The index of a key is the position of its entry in dirents.
+    class CompareTitle
+    {
+        const std::vector<Dirent>* dirents;
+
+      public:
+        CompareTitle()
+          : dirents(0)
+          { }
+        explicit CompareTitle(const std::vector<Dirent>& dirents_)
+          : dirents(&dirents_)
+          { }
+
+        bool operator() (const TitleKey& k1, const TitleKey& k2) const
+        {
+          if (k1.prefix != k2.prefix)
+            return k1.prefix < k2.prefix;
+
+          // same namespace and same start of the title
+          const std::string& t1 = (*dirents)[k1.idx].getTitle();
+          const std::string& t2 = (*dirents)[k2.idx].getTitle();
+          int c = t1.size() > 7 && t2.size() > 7
+                ? t1.compare(7, std::string::npos, t2, 7, std::string::npos)
+                : t1.compare(t2);
+          return c < 0 || (c == 0 && k1.idx < k2.idx);
+        }
+    };
+
+  }
+}
+
+#endif // ZIM_WRITER_TITLEKEY_H
@@ -21,6 +21,7 @@
 #include <sstream>
 #include <fstream>
 #include <set>
+#include <vector>
 #include <zim/file.h>
 #include <zim/fileiterator.h>
 #include <zim/zintstream.h>
@@ -29,6 +30,9 @@
 #include <stdexcept>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <iomanip>
 
 log_define("zim.dumper")
 
@@ -64,6 +68,7 @@ class ZimDumper
       { listArticleT(*pos, extra); }
     void dumpFiles(const std::string& directory);
     void verifyChecksum();
+    void verifyClusters();
 };
 
 void ZimDumper::printInfo()
@@ -146,7 +151,15 @@ void ZimDumper::dumpArticle()
   log_trace("dump article");
   if(pos!=file.end())
   {
-    std::cout << pos->getData() << std::flush;
+    // uncompressed data is sent directly from the file
+    zim::FileRegion region = pos->getFileRegion();
+    if (region.good())
+    {
+      std::cout.flush();
+      region.sendTo(STDOUT_FILENO);
+    }
+    else
+      std::cout << pos->getData() << std::flush;
   }
 }
 
@@ -422,12 +435,98 @@ void ZimDumper::dumpFiles(const std::string& directory)
   }
 }
 
+namespace
+{
+  double now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+  }
+
+  // Shows the progress of the verification on a terminal.
+  class ProgressPrinter : public zim::VerifyProgress
+  {
+      bool show;
+      unsigned percent;
+
+    public:
+      ProgressPrinter()
+        : show(isatty(2)),
+          percent(0)
+        { }
+
+      ~ProgressPrinter()
+      {
+        if (show && percent > 0)
+          std::cerr << std::endl;
+      }
+
+      void onProgress(zim::offset_type done, zim::offset_type total)
+      {
+        unsigned p = total > 0 ? done * 100 / total : 100;
+        if (show && p != percent)
+        {
+          percent = p;
+          std::cerr << "\rverify checksum " << p << '%' << std::flush;
+        }
+      }
+  };
+}
+
 void ZimDumper::verifyChecksum()
 {
-  if (file.verify())
-    std::cout << "checksum ok" << std::endl;
-  else
+  double start = now();
+  bool ok;
+
+  {
+    ProgressPrinter progress;
+    ok = file.verify(&progress);
+  }
+
+  if (!ok)
+  {
     std::cout << "no checksum" << std::endl;
+    return;
+  }
+
+  double t = now() - start;
+  double mb = file.getFileheader().getChecksumPos() / (1024.0 * 1024.0);
+  std::cout << "checksum ok" << std::endl;
+  std::cout << std::fixed << std::setprecision(1)
+            << mb << " MB verified in " << std::setprecision(2) << t << " s";
+  if (t > 0)
+    std::cout << " (" << std::setprecision(1) << mb / t << " MB/s)";
+  std::cout << std::endl;
+}
+
+void ZimDumper::verifyClusters()
+{
+  double start = now();
+  std::vector<zim::size_type> corrupt;
+  bool ok;
+
+  {
+    ProgressPrinter progress;
+    ok = file.verifyClusters(corrupt, 0, &progress);
+  }
+
+  if (!ok)
+  {
+    std::cout << "no cluster checksums" << std::endl;
+    return;
+  }
+
+  double t = now() - start;
+  for (std::vector<zim::size_type>::const_iterator it = corrupt.begin(); it != corrupt.end(); ++it)
+    std::cout << "checksum error in cluster " << *it << std::endl;
+
+  std::cout << file.getClusterChecksumCount() - corrupt.size() << " of "
+            << file.getClusterChecksumCount() << " clusters ok in "
+            << std::fixed << std::setprecision(2) << t << " s" << std::endl;
+
+  if (!corrupt.empty())
+    throw std::runtime_error("damaged clusters found");
 }
 
 int main(int argc, char* argv[])
@@ -453,6 +552,7 @@ int main(int argc, char* argv[])
     zim::Arg<bool> zint(argc, argv, 'Z');
     zim::Arg<bool> titleSort(argc, argv, 't');
     zim::Arg<bool> verifyChecksum(argc, argv, 'C');
+    zim::Arg<bool> verifyClusters(argc, argv, 'K');
 
     if (argc <= 1)
     {
@@ -477,6 +577,7 @@ int main(int argc, char* argv[])
                    "                    (print namespaces with counts with -F)\n"
                    "  -Z        dump index data\n"
                    "  -C        verify checksum\n"
+                   "  -K        verify cluster checksums in parallel\n"
                    "\n"
                    "examples:\n"
                    "  " << argv[0] << " -F wikipedia.zim\n"
@@ -526,6 +627,9 @@ int main(int argc, char* argv[])
     else if (zint)
       app.dumpIndex();
 
+    if (verifyClusters)
+      app.verifyClusters();
+
     if (verifyChecksum)
       app.verifyChecksum();
   }
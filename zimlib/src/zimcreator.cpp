@@ -32,12 +32,23 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
+#include <cstring>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sstream>
 #include <limits>
 #include <stdexcept>
 #include "config.h"
 #include "arg.h"
-#include "md5stream.h"
-#include "tee.h"
+#include "clusterwriter.h"
+#include "articlequeue.h"
+#include "localityorder.h"
+#include "direntspill.h"
+#include "parallelsort.h"
+#include "titlekey.h"
+#include "md5writer.h"
+#include "md5.h"
 #include "log.h"
 
 log_define("zim.writer.creator")
@@ -52,8 +63,249 @@ namespace zim
 {
   namespace writer
   {
+    namespace
+    {
+      // Hash table, which maps the aids of the directory entries to their
+      // positions. The table stores positions only and compares the aids
+      // of the entries.
+      class AidIndex
+      {
+          const ZimCreator::DirentsType& dirents;
+          std::vector<size_type> slots;  // position + 1; 0 is empty
+          size_type mask;
+
+          static size_type hash(const std::string& s)
+          {
+            // FNV-1a
+            size_type h = 2166136261u;
+            for (std::string::const_iterator it = s.begin(); it != s.end(); ++it)
+              h = (h ^ static_cast<unsigned char>(*it)) * 16777619u;
+            return h;
+          }
+
+        public:
+          explicit AidIndex(const ZimCreator::DirentsType& dirents_);
+
+          // Returns the position of the first entry with the aid or
+          // missingTarget.
+          size_type find(const std::string& aid) const;
+      };
+
+      AidIndex::AidIndex(const ZimCreator::DirentsType& dirents_)
+        : dirents(dirents_)
+      {
+        size_type size = 16;
+        while (size < dirents.size() * 2)
+          size *= 2;
+        slots.resize(size);
+        mask = size - 1;
+
+        for (ZimCreator::DirentsType::size_type pos = 0; pos < dirents.size(); ++pos)
+        {
+          const std::string& aid = dirents[pos].getAid();
+          size_type s = hash(aid) & mask;
+          while (slots[s] != 0 && dirents[slots[s] - 1].getAid() != aid)
+            s = (s + 1) & mask;
+          if (slots[s] == 0)
+            slots[s] = pos + 1;
+        }
+      }
+
+      size_type AidIndex::find(const std::string& aid) const
+      {
+        size_type s = hash(aid) & mask;
+        while (slots[s] != 0)
+        {
+          if (dirents[slots[s] - 1].getAid() == aid)
+            return slots[s] - 1;
+          s = (s + 1) & mask;
+        }
+        return missingTarget;
+      }
+
+      const size_type unusedSlot = std::numeric_limits<size_type>::max();
+
+      // Hash table, which maps the MD5 sum and size of blobs to the place,
+      // where the blob is stored. The place is the serial number of the
+      // cluster, in which it was added, and the blob number. The table
+      // grows up to a maximum size; then new entries replace old ones.
+      class BlobIndex
+      {
+        public:
+          struct Entry
+          {
+            unsigned char digest[16];
+            size_type size;
+            size_type serial;
+            size_type blob;
+          };
+
+        private:
+          static const unsigned maxProbes = 8;
+
+          std::vector<Entry> slots;
+          size_type maxSlots;
+          size_type used;
+
+          static size_type hash(const unsigned char digest[16])
+            { return digest[0] | digest[1] << 8 | digest[2] << 16 | static_cast<size_type>(digest[3]) << 24; }
+
+          void grow();
+          void put(const Entry& entry);
+
+        public:
+          explicit BlobIndex(offset_type maxMemory);
+
+          // Returns the entry of an identical blob or 0.
+          const Entry* find(const unsigned char digest[16], size_type size) const;
+          void insert(const unsigned char digest[16], size_type size, size_type serial, size_type blob);
+      };
+
+      BlobIndex::BlobIndex(offset_type maxMemory)
+        : maxSlots(16),
+          used(0)
+      {
+        while (maxSlots * 2 * sizeof(Entry) <= maxMemory)
+          maxSlots *= 2;
+
+        slots.resize(std::min<size_type>(maxSlots, 1024));
+        for (std::vector<Entry>::iterator it = slots.begin(); it != slots.end(); ++it)
+          it->serial = unusedSlot;
+      }
+
+      const BlobIndex::Entry* BlobIndex::find(const unsigned char digest[16], size_type size) const
+      {
+        size_type mask = slots.size() - 1;
+        size_type s = hash(digest) & mask;
+        for (unsigned n = 0; n < maxProbes && slots[s].serial != unusedSlot; ++n, s = (s + 1) & mask)
+        {
+          if (slots[s].size == size && std::memcmp(slots[s].digest, digest, 16) == 0)
+            return &slots[s];
+        }
+
+        return 0;
+      }
+
+      void BlobIndex::put(const Entry& entry)
+      {
+        // when no slot near the home slot is free, the home slot is replaced
+        size_type mask = slots.size() - 1;
+        size_type home = hash(entry.digest) & mask;
+        size_type s = home;
+        for (unsigned n = 0; n < maxProbes; ++n, s = (s + 1) & mask)
+        {
+          if (slots[s].serial == unusedSlot)
+          {
+            slots[s] = entry;
+            ++used;
+            return;
+          }
+        }
+
+        slots[home] = entry;
+      }
+
+      void BlobIndex::grow()
+      {
+        std::vector<Entry> old(slots.size() * 2);
+        old.swap(slots);
+        for (std::vector<Entry>::iterator it = slots.begin(); it != slots.end(); ++it)
+          it->serial = unusedSlot;
+
+        used = 0;
+        for (std::vector<Entry>::const_iterator it = old.begin(); it != old.end(); ++it)
+          if (it->serial != unusedSlot)
+            put(*it);
+      }
+
+      void BlobIndex::insert(const unsigned char digest[16], size_type size, size_type serial, size_type blob)
+      {
+        if (used >= slots.size() / 2 && slots.size() < maxSlots)
+          grow();
+
+        Entry entry;
+        std::memcpy(entry.digest, digest, 16);
+        entry.size = size;
+        entry.serial = serial;
+        entry.blob = blob;
+        put(entry);
+      }
+
+      const uint32_t uncompressedGroup = 0xffffffff;
+
+      // Returns the minimum of the hashes of all 8 byte shingles of the
+      // start of the data. Two blobs get the same value with a probability
+      // equal to the similarity of their shingle sets.
+      uint32_t minHash(const char* data, size_type size)
+      {
+        const size_type maxSize = 4096;
+        if (size > maxSize)
+          size = maxSize;
+
+        uint32_t ret = std::numeric_limits<uint32_t>::max();
+        for (size_type n = 0; n + 8 <= size; ++n)
+        {
+          uint64_t v;
+          std::memcpy(&v, data + n, 8);
+          uint32_t h = static_cast<uint32_t>((v * 0x9e3779b97f4a7c15ull) >> 32);
+          if (h < ret)
+            ret = h;
+        }
+
+        return ret;
+      }
+
+      unsigned defaultCompressThreads()
+      {
+#if defined(_SC_NPROCESSORS_ONLN)
+        long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+        if (n > 0)
+          return n;
+#endif
+        return 1;
+      }
+
+      void throwError(const char* fn)
+      {
+        std::ostringstream msg;
+        msg << fn << " failed with errno " << errno << " : " << strerror(errno);
+        throw std::runtime_error(msg.str());
+      }
+
+      offset_type getFileSize(const std::string& fname)
+      {
+        struct stat st;
+        if (::stat(fname.c_str(), &st) != 0)
+        {
+          std::ostringstream msg;
+          msg << "stat of file " << fname << " failed with errno " << errno << " : " << strerror(errno);
+          throw std::runtime_error(msg.str());
+        }
+        return st.st_size;
+      }
+
+      void readFile(const std::string& fname, std::string& data)
+      {
+        std::ifstream in(fname.c_str(), std::ios::in | std::ios::binary);
+        std::ostringstream s;
+        if (!in || !(s << in.rdbuf()))
+          throw std::runtime_error("failed to read file " + fname);
+        data = s.str();
+      }
+    }
+
+    struct ZimCreator::OpenCluster
+    {
+      Cluster cluster;
+      DirentPtrsType dirents;  // entries, which get the cluster number
+      size_type serial;
+      uint32_t group;
+      size_type lastUse;
+    };
+
     ZimCreator::ZimCreator()
       : minChunkSize(1024-64),
+        compressThreads(defaultCompressThreads()),
         nextMimeIdx(0),
 #ifdef ENABLE_LZMA
         compression(zimcompLzma),
@@ -64,7 +316,26 @@ namespace zim
 #else
         compression(zimcompNone),
 #endif
-        currentSize(0)
+        classicLayout(false),
+        clusterChecksums(false),
+        directoryFirst(false),
+        tmpClustersPos(0),
+        currentSize(0),
+        maxDirentMemory(0),
+        direntMemory(0),
+        direntSpill(0),
+        dedupMemory(0),
+        clusterGroups(1),
+        similarityBuckets(0),
+        localityPlacement(false),
+        largeBlobSize(0),
+        minSaving(0),
+        fastCodecTolerance(0),
+        nextSerial(0),
+        useCounter(0),
+        articleQueue(0),
+        maxQueuedArticles(4096),
+        maxQueuedBytes(64 * 1024 * 1024)
     {
     }
 
@@ -79,7 +350,26 @@ namespace zim
 #else
         compression(zimcompNone),
 #endif
-        currentSize(0)
+        classicLayout(false),
+        clusterChecksums(false),
+        directoryFirst(false),
+        tmpClustersPos(0),
+        currentSize(0),
+        maxDirentMemory(0),
+        direntMemory(0),
+        direntSpill(0),
+        dedupMemory(0),
+        clusterGroups(1),
+        similarityBuckets(0),
+        localityPlacement(false),
+        largeBlobSize(0),
+        minSaving(0),
+        fastCodecTolerance(0),
+        nextSerial(0),
+        useCounter(0),
+        articleQueue(0),
+        maxQueuedArticles(4096),
+        maxQueuedBytes(64 * 1024 * 1024)
     {
       Arg<unsigned> minChunkSizeArg(argc, argv, "--min-chunk-size");
       if (minChunkSizeArg.isSet())
@@ -87,6 +377,18 @@ namespace zim
       else
         minChunkSize = Arg<unsigned>(argc, argv, 's', 1024-64);
 
+      compressThreads = Arg<unsigned>(argc, argv, "--compress-threads", defaultCompressThreads());
+      maxDirentMemory = Arg<unsigned>(argc, argv, "--dirent-memory") * offset_type(1024 * 1024);
+      classicLayout = Arg<bool>(argc, argv, "--classic-layout");
+      clusterChecksums = Arg<bool>(argc, argv, "--cluster-checksums");
+      dedupMemory = Arg<unsigned>(argc, argv, "--dedup-memory") * offset_type(1024 * 1024);
+      setClusterGroups(Arg<unsigned>(argc, argv, "--cluster-groups", 1));
+      similarityBuckets = Arg<unsigned>(argc, argv, "--similarity-buckets");
+      localityPlacement = Arg<bool>(argc, argv, "--locality");
+      largeBlobSize = Arg<unsigned>(argc, argv, "--large-blob-size");
+      minSaving = Arg<unsigned>(argc, argv, "--min-saving");
+      fastCodecTolerance = Arg<unsigned>(argc, argv, "--fast-codec-tolerance");
+
 #ifdef ENABLE_ZLIB
       if (Arg<bool>(argc, argv, "--zlib"))
         compression = zimcompZip;
@@ -101,6 +403,79 @@ namespace zim
 #endif
     }
 
+    ZimCreator::~ZimCreator()
+    {
+      if (articleQueue)
+      {
+        articleQueue->close();
+        ::pthread_join(creatorThread, 0);
+        delete articleQueue;
+      }
+
+      delete direntSpill;
+    }
+
+    void ZimCreator::startZimCreation(const std::string& fname)
+    {
+      if (articleQueue)
+        throw std::runtime_error("zim creation already started");
+
+      creatorFilename = fname;
+      creatorError.clear();
+      articleQueue = new ArticleQueue(maxQueuedArticles, maxQueuedBytes, mainPage, layoutPage);
+
+      int ret = ::pthread_create(&creatorThread, 0, creatorThreadStart, this);
+      if (ret != 0)
+      {
+        delete articleQueue;
+        articleQueue = 0;
+        std::ostringstream msg;
+        msg << "failed to create thread; error " << ret << " : " << strerror(ret);
+        throw std::runtime_error(msg.str());
+      }
+    }
+
+    void ZimCreator::addArticle(const Article& article)
+    {
+      if (!articleQueue)
+        throw std::runtime_error("zim creation not started");
+      articleQueue->push(article);
+    }
+
+    void ZimCreator::finishZimCreation()
+    {
+      if (!articleQueue)
+        throw std::runtime_error("zim creation not started");
+
+      articleQueue->close();
+      ::pthread_join(creatorThread, 0);
+      delete articleQueue;
+      articleQueue = 0;
+
+      if (!creatorError.empty())
+        throw std::runtime_error(creatorError);
+    }
+
+    void* ZimCreator::creatorThreadStart(void* arg)
+    {
+      static_cast<ZimCreator*>(arg)->runCreator();
+      return 0;
+    }
+
+    void ZimCreator::runCreator()
+    {
+      try
+      {
+        create(creatorFilename, *articleQueue);
+      }
+      catch (const std::exception& e)
+      {
+        log_error("zim creation failed: " << e.what());
+        creatorError = e.what();
+        articleQueue->setError(e.what());
+      }
+    }
+
     void ZimCreator::create(const std::string& fname, ArticleSource& src)
     {
       isEmpty = true;
@@ -113,12 +488,12 @@ namespace zim
       src.setFilename(fname);
 
       INFO("create directory entries");
-      createDirentsAndClusters(src, basename + ".tmp");
-      INFO(dirents.size() << " directory entries created");
+      createDirentsAndClusters(src, basename + ".zim", basename + ".tmp");
+      INFO(articleCount() << " directory entries created");
 
       INFO("create title index");
       createTitleIndex(src);
-      INFO(dirents.size() << " title index created");
+      INFO(titleIdx.size() << " title index created");
       INFO(clusterOffsets.size() << " clusters created");
 
       INFO("fill header");
@@ -126,33 +501,84 @@ namespace zim
 
       INFO("write zimfile");
       write(basename + ".zim", basename + ".tmp");
-
       ::remove((basename + ".tmp").c_str());
 
+      if (!directoryFirst)
+      {
+        INFO("write checksum");
+        writeChecksum(basename + ".zim");
+      }
+
+      delete direntSpill;
+      direntSpill = 0;
+
       INFO("ready");
     }
 
-    void ZimCreator::createDirentsAndClusters(ArticleSource& src, const std::string& tmpfname)
+    void ZimCreator::createDirentsAndClusters(ArticleSource& src, const std::string& fname, const std::string& tmpfname)
     {
       INFO("collect articles");
-      std::ofstream out(tmpfname.c_str());
+
+      // The clusters are written directly into the zim file behind the
+      // space for the header and the mime type list. In the classic layout
+      // they are collected in a temporary file and copied later.
+      directoryFirst = classicLayout;
+      tmpClustersPos = 0;
+      std::ofstream out;
+      if (directoryFirst)
+        out.open(tmpfname.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+      else
+      {
+        out.open(fname.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        out.seekp(reservedSize);
+      }
+
+      if (!out)
+        throw std::runtime_error("failed to create file " + (directoryFirst ? tmpfname : fname));
+
       currentSize =
         80 /* for header */ +
         1 /* for mime type table termination */ +
         16 /* for md5sum */;
 
-      // We keep both a "compressed cluster" and an "uncompressed cluster"
-      // because we don't know which one will fill up first.  We also need
-      // to track the dirents currently in each, so we can fix up the
-      // cluster index if the other one ends up written first.
-      DirentPtrsType compDirents, uncompDirents;
-      Cluster compCluster, uncompCluster;
-      compCluster.setCompression(compression);
-      uncompCluster.setCompression(zimcompNone);
+      // Full clusters are compressed and written in the background. The
+      // offsets are recorded by the writer in the order of the clusters.
+      ClusterWriter clusterWriter(out, compressThreads);
+      clusterWriter.setChecksums(clusterChecksums);
+      clusterWriter.setMinSaving(minSaving);
+      clusterWriter.setFastCodecTolerance(fastCodecTolerance);
+      offset_type clustersWritten = 0;
+
+      // We keep several compressed clusters and an uncompressed cluster
+      // open, since we don't know which one will fill up first. Each
+      // cluster gets a serial number, when it is opened, so that the blob
+      // index can refer to clusters, which have no number yet.
+      OpenClusters openClusters;
+      openClusters.reserve(clusterGroups + 1);
+      clusterNumbers.clear();
+      nextSerial = 0;
+
+      BlobIndex blobIndex(dedupMemory);
+      size_type dedupCount = 0;
+      offset_type dedupSize = 0;
+      size_type largeCount = 0;
+
+      delete direntSpill;
+      direntSpill = 0;
+      direntMemory = 0;
+
+      // With locality placement the articles are reordered, so that pages
+      // are followed by their assets, and the compressed blobs are put into
+      // clusters in this order.
+      LocalityOrder ordered(src, minChunkSize * 1024 / 2);
+      ArticleSource& articles = localityPlacement ? static_cast<ArticleSource&>(ordered) : src;
 
       const Article* article;
-      while ((article = src.getNextArticle()) != 0)
+      while ((article = articles.getNextArticle()) != 0)
       {
+        if (maxDirentMemory > 0 && direntMemory > maxDirentMemory)
+          spillDirents(tmpfname, openClusters);
+
         Dirent dirent;
         dirent.setAid(article->getAid());
         dirent.setUrl(article->getNamespace(), article->getUrl());
@@ -194,6 +620,7 @@ namespace zim
           sizeof(offset_type) /* for url pointer list */ +
           sizeof(size_type) /* for title pointer list */;
         dirents.push_back(dirent);
+        direntMemory += recordSize(dirent);
 
         // If this is a redirect, we're done: there's no blob to add.
         if (dirent.isRedirect())
@@ -201,185 +628,421 @@ namespace zim
           continue;
         }
 
-        // Add blob data to compressed or uncompressed cluster.
-        Blob blob = article->getData();
-        if (blob.size() > 0)
+        // Add blob data to compressed or uncompressed cluster. The data
+        // of a large file is not read here but passed to the cluster writer,
+        // which copies it in chunks.
+        Blob blob;
+        std::string fileData;
+        std::string dataPath = article->getDataPath();
+        offset_type dataSize;
+        bool streamed = false;
+        if (dataPath.empty())
+        {
+          blob = article->getData();
+          dataSize = blob.size();
+        }
+        else
+        {
+          // Files, which are too large to share a cluster with other blobs
+          // or which are isolated as large blobs, are streamed into a
+          // cluster of their own.
+          dataSize = getFileSize(dataPath);
+          streamed = dataSize >= offset_type(minChunkSize) * 1024
+                  || (largeBlobSize > 0 && dataSize >= offset_type(largeBlobSize) * 1024);
+          if (!streamed)
+          {
+            readFile(dataPath, fileData);
+            blob = Blob(fileData.data(), fileData.size());
+            dataSize = blob.size();
+          }
+        }
+
+        if (dataSize > 0)
         {
           isEmpty = false;
         }
 
-        Cluster *cluster;
-        DirentPtrsType *myDirents, *otherDirents;
-        if (dirent.isCompress())
+        // Identical blobs are stored only once. The entry just points to
+        // the blob, which was added first. While that blob is in an open
+        // cluster, the data is compared, so that different blobs with the
+        // same MD5 sum are not merged. Blobs in written clusters are only
+        // compared by MD5 sum and size.
+        unsigned char digest[16];
+        if (dedupMemory > 0 && blob.size() > 0)
         {
-          cluster = &compCluster;
-          myDirents = &compDirents;
-          otherDirents = &uncompDirents;
+          zim_MD5_CTX context;
+          zim_MD5Init(&context);
+          zim_MD5Update(&context, reinterpret_cast<const unsigned char*>(blob.data()), blob.size());
+          zim_MD5Final(digest, &context);
+
+          const BlobIndex::Entry* entry = blobIndex.find(digest, blob.size());
+          OpenClusters::iterator open = openClusters.begin();
+          if (entry)
+          {
+            while (open != openClusters.end() && open->serial != entry->serial)
+              ++open;
+
+            if (open != openClusters.end()
+              && std::memcmp(open->cluster.getBlobPtr(entry->blob), blob.data(), blob.size()) != 0)
+            {
+              log_warn("blob of " << dirent.getLongUrl() << " has the md5 sum of a different blob");
+              entry = 0;
+            }
+          }
+
+          if (entry)
+          {
+            log_debug("blob of " << dirent.getLongUrl() << " is already stored");
+
+            if (open != openClusters.end())
+              open->dirents.push_back(dirents.size() - 1);
+
+            size_type clusterNumber = entry->serial < clusterNumbers.size() ? clusterNumbers[entry->serial] : 0;
+            dirents.back().setCluster(clusterNumber, entry->blob);
+
+            ++dedupCount;
+            dedupSize += blob.size();
+            continue;
+          }
         }
-        else
+
+        // Large blobs get a cluster of their own, so that reading the small
+        // blobs does not need to decompress or cache them. Blobs of already
+        // compressed mime types are stored uncompressed, so that they can
+        // be read in ranges.
+        if (streamed || (largeBlobSize > 0 && dataSize >= offset_type(largeBlobSize) * 1024))
         {
-          cluster = &uncompCluster;
-          myDirents = &uncompDirents;
-          otherDirents = &compDirents;
+          log_debug("large blob of " << dirent.getLongUrl() << " with " << dataSize << " bytes");
+
+          OpenCluster single;
+          single.cluster.setCompression(dirent.isCompress() ? compression : zimcompNone);
+          single.serial = nextSerial++;
+
+          if (dedupMemory > 0 && blob.size() > 0)
+            blobIndex.insert(digest, blob.size(), single.serial, 0);
+
+          dirents.back().setCluster(0, 0);
+          if (blob.size() > 0)
+            single.cluster.addBlob(blob);
+          else
+          {
+            // the offsets in a cluster are 32 bit
+            if (dataSize > std::numeric_limits<size_type>::max() - 2 * sizeof(size_type))
+              throw std::runtime_error("file " + dataPath + " is too large for a cluster");
+            single.cluster.addBlobFile(dataPath, dataSize);
+          }
+          single.dirents.push_back(dirents.size()-1);
+          closeOpenCluster(clusterWriter, single);
+
+          ++largeCount;
+          offset_type written = clusterWriter.getWrittenSize();
+          currentSize += written - clustersWritten;
+          clustersWritten = written;
+          continue;
         }
 
-        // If cluster will be too large, write it to dis, and open a new
-        // one for the content.
-        if ( cluster->count()
-          && cluster->size()+blob.size() >= minChunkSize * 1024
+        OpenCluster& open = getOpenCluster(clusterWriter, openClusters, clusterGroup(dirent, blob));
+
+        // If cluster will be too large, pass it to the writer, and open a
+        // new one for the content.
+        if ( open.cluster.count()
+          && open.cluster.size()+blob.size() >= minChunkSize * 1024
            )
         {
-          log_info("cluster with " << cluster->count() << " articles, " <<
-                   cluster->size() << " bytes; current title \"" <<
+          log_info("cluster with " << open.cluster.count() << " articles, " <<
+                   open.cluster.size() << " bytes; current title \"" <<
                    dirent.getTitle() << '\"');
-          offset_type start = out.tellp();
-          clusterOffsets.push_back(start);
-          out << *cluster;
-          log_debug("cluster written");
-          cluster->clear();
-          myDirents->clear();
-          // Update the cluster number of the dirents *not* written to disk.
-          for (DirentPtrsType::iterator dpi = otherDirents->begin();
-               dpi != otherDirents->end(); ++dpi)
-          {
-            Dirent *di = &dirents[*dpi];
-            di->setCluster(clusterOffsets.size(), di->getBlobNumber());
-          }
-          offset_type end = out.tellp();
-          currentSize += (end - start) +
-            sizeof(offset_type) /* for cluster pointer entry */;
+          closeOpenCluster(clusterWriter, open);
         }
 
-        dirents.back().setCluster(clusterOffsets.size(), cluster->count());
-        cluster->addBlob(blob);
-        myDirents->push_back(dirents.size()-1);
+        if (dedupMemory > 0 && blob.size() > 0)
+          blobIndex.insert(digest, blob.size(), open.serial, open.cluster.count());
+
+        dirents.back().setCluster(0, open.cluster.count());
+        open.cluster.addBlob(blob);
+        open.dirents.push_back(dirents.size()-1);
+
+        offset_type written = clusterWriter.getWrittenSize();
+        currentSize += written - clustersWritten;
+        clustersWritten = written;
       }
 
-      // When we've seen all articles, write any remaining clusters.
-      if (compCluster.count() > 0)
+      // When we've seen all articles, write any remaining clusters; the
+      // uncompressed cluster is written last.
+      for (unsigned pass = 0; pass < 2; ++pass)
       {
-        clusterOffsets.push_back(out.tellp());
-        out << compCluster;
-        for (DirentPtrsType::iterator dpi = uncompDirents.begin();
-             dpi != uncompDirents.end(); ++dpi)
-        {
-          Dirent *di = &dirents[*dpi];
-          di->setCluster(clusterOffsets.size(), di->getBlobNumber());
-        }
+        for (OpenClusters::iterator it = openClusters.begin(); it != openClusters.end(); ++it)
+          if ((it->group == uncompressedGroup) == (pass == 1) && it->cluster.count() > 0)
+            closeOpenCluster(clusterWriter, *it);
       }
-      compCluster.clear();
-      compDirents.clear();
 
-      if (uncompCluster.count() > 0)
+      if (largeCount > 0)
+        INFO(largeCount << " large blobs stored in clusters of their own");
+
+      if (dedupCount > 0)
+        INFO(dedupCount << " duplicate blobs with " << dedupSize << " bytes stored only once");
+
+      if (clusterChecksums && !isEmpty)
+        addChecksumTable(clusterWriter);
+
+      clusterWriter.finish();
+
+      // the cluster offsets are kept relative to the start of the clusters
+      offset_type start = directoryFirst ? 0 : reservedSize;
+      clusterOffsets = clusterWriter.getOffsets();
+      for (OffsetsType::iterator it = clusterOffsets.begin(); it != clusterOffsets.end(); ++it)
+        *it -= start;
+
+      clustersSize = out.tellp() - std::streampos(start);
+      out.close();
+
+      if (out.fail())
+        throw std::runtime_error("failed to write clusters");
+
+      // The mime type list is known only now. When it does not fit into the
+      // reserved space, the clusters are moved out of the way and the file
+      // is written in the classic layout.
+      if (!directoryFirst && mimeListPos() + mimeListSize() > reservedSize)
       {
-        clusterOffsets.push_back(out.tellp());
-        out << uncompCluster;
+        log_warn("mime type list does not fit into the reserved space; use classic layout");
+        if (::rename(fname.c_str(), tmpfname.c_str()) != 0)
+          throwError("rename");
+        directoryFirst = true;
+        tmpClustersPos = reservedSize;
       }
-      uncompCluster.clear();
-      uncompDirents.clear();
 
-      if (!out)
+      if (direntSpill)
       {
-        throw std::runtime_error("failed to write temporary cluster file");
+        for (DirentsType::const_iterator it = dirents.begin(); it != dirents.end(); ++it)
+          direntSpill->add(*it);
+        DirentsType().swap(dirents);
+
+        INFO("sort directory entries in temporary files");
+        direntSpill->finish(src.getMainPage(), src.getLayoutPage(), titleIdx);
+        return;
       }
 
-      clustersSize = out.tellp();
+      // sort once by url; the position in this order identifies an entry
+      INFO("sort " << dirents.size() << " directory entries (url)");
+      parallelSort(dirents.begin(), dirents.end(), CompareUrl(), sortThreads());
+
+      // translate redirect aids to positions
+      INFO("resolve redirects");
+      std::vector<size_type> redirectIdx(dirents.size(), notRedirect);
+      {
+        AidIndex aidIndex(dirents);
+        for (DirentsType::size_type pos = 0; pos < dirents.size(); ++pos)
+        {
+          if (dirents[pos].isRedirect())
+            redirectIdx[pos] = aidIndex.find(dirents[pos].getRedirectAid());
+        }
+      }
 
-      // sort
-      INFO("sort " << dirents.size() << " directory entries (aid)");
-      std::sort(dirents.begin(), dirents.end(), compareAid);
+      std::vector<bool> removed;
+      std::vector<size_type> idx;
+      size_type count = removeInvalidRedirects(redirectIdx, removed, idx);
 
-      // remove invalid redirects
-      INFO("remove invalid redirects from " << dirents.size() << " directory entries");
-      DirentsType::size_type di = 0;
-      while (di < dirents.size())
+      // remove invalid redirects and set index
+      INFO("remove " << dirents.size() - count << " invalid redirects");
+      DirentsType::size_type n = 0;
+      for (DirentsType::size_type pos = 0; pos < dirents.size(); ++pos)
       {
-        if (dirents[di].isRedirect())
+        if (removed[pos])
         {
-          log_debug("check " << dirents[di].getTitle() << " redirect to " << dirents[di].getRedirectAid() << " (" << di << '/' << dirents.size() << ')');
+          log_debug("remove invalid redirection " << dirents[pos].getTitle());
+          continue;
+        }
 
-          if (!std::binary_search(dirents.begin(), dirents.end(), Dirent(dirents[di].getRedirectAid()), compareAid))
-          {
-            log_debug("remove invalid redirection " << dirents[di].getTitle());
-            dirents.erase(dirents.begin() + di);
-            continue;
-          }
+        Dirent& dirent = dirents[pos];
+        if (dirent.isRedirect())
+        {
+          log_debug("redirect aid=" << dirent.getRedirectAid() << " redirect index=" << redirectIdx[pos]);
+          dirent.setRedirect(redirectIdx[pos]);
         }
+        dirent.setIdx(n);
 
-        ++di;
+        if (n != pos)
+          std::swap(dirents[n], dirent);
+        ++n;
       }
 
-      // sort
-      INFO("sort " << dirents.size() << " directory entries (url)");
-      std::sort(dirents.begin(), dirents.end(), compareUrl);
+      dirents.erase(dirents.begin() + n, dirents.end());
+    }
+
+    size_type ZimCreator::closeCluster(ClusterWriter& clusterWriter, Cluster& cluster, DirentPtrsType& clusterDirents)
+    {
+      size_type clusterNumber = clusterWriter.add(cluster);
+
+      for (DirentPtrsType::iterator dpi = clusterDirents.begin();
+           dpi != clusterDirents.end(); ++dpi)
+      {
+        Dirent *di = &dirents[*dpi];
+        di->setCluster(clusterNumber, di->getBlobNumber());
+      }
+
+      // the writer owns the cluster now, so start a new one
+      CompressionType c = cluster.getCompression();
+      cluster = Cluster();
+      cluster.setCompression(c);
+      clusterDirents.clear();
 
-      // set index
-      INFO("set index");
-      unsigned idx = 0;
-      for (DirentsType::iterator di = dirents.begin(); di != dirents.end(); ++di)
-        di->setIdx(idx++);
+      return clusterNumber;
+    }
 
-      // sort
-      log_debug("sort " << dirents.size() << " directory entries (aid)");
-      std::sort(dirents.begin(), dirents.end(), compareAid);
+    void ZimCreator::closeOpenCluster(ClusterWriter& clusterWriter, OpenCluster& open)
+    {
+      size_type clusterNumber = closeCluster(clusterWriter, open.cluster, open.dirents);
+      currentSize += sizeof(offset_type) /* for cluster pointer entry */;
 
-      // translate redirect aid to index
-      INFO("translate redirect aid to index");
-      for (DirentsType::iterator di = dirents.begin(); di != dirents.end(); ++di)
+      if (clusterNumbers.size() <= open.serial)
+        clusterNumbers.resize(open.serial + 1);
+      clusterNumbers[open.serial] = clusterNumber;
+      open.serial = nextSerial++;
+    }
+
+    ZimCreator::OpenCluster& ZimCreator::getOpenCluster(ClusterWriter& clusterWriter, OpenClusters& openClusters, uint32_t group)
+    {
+      OpenClusters::iterator lru = openClusters.end();
+      unsigned compressed = 0;
+      for (OpenClusters::iterator it = openClusters.begin(); it != openClusters.end(); ++it)
       {
-        if (di->isRedirect())
+        if (it->group == group)
         {
-          DirentsType::iterator ddi = std::lower_bound(dirents.begin(), dirents.end(), di->getRedirectAid(), compareAid);
-          if (ddi != dirents.end() && ddi->getAid() == di->getRedirectAid())
-          {
-            log_debug("redirect aid=" << ddi->getAid() << " redirect index=" << ddi->getIdx());
-            di->setRedirect(ddi->getIdx());
-          }
-          else
-          {
-            std::ostringstream msg;
-            msg << "internal error: redirect aid " << di->getRedirectAid() << " not found";
-            log_fatal(msg.str());
-            throw std::runtime_error(msg.str());
-          }
+          it->lastUse = ++useCounter;
+          return *it;
+        }
+
+        if (it->group != uncompressedGroup)
+        {
+          ++compressed;
+          if (lru == openClusters.end() || it->lastUse < lru->lastUse)
+            lru = it;
+        }
+      }
+
+      // When all groups are in use, the least recently used cluster is
+      // closed and its slot is used for the new group. A cluster, which is
+      // still small, is not closed; it takes the blob instead, so that
+      // many groups do not result in many tiny clusters.
+      if (group != uncompressedGroup && compressed >= clusterGroups)
+      {
+        if (lru->cluster.size() < minChunkSize * 1024 / 4)
+        {
+          lru->lastUse = ++useCounter;
+          return *lru;
         }
+
+        if (lru->cluster.count() > 0)
+          closeOpenCluster(clusterWriter, *lru);
+        lru->group = group;
+        lru->lastUse = ++useCounter;
+        return *lru;
       }
 
-      // sort
-      log_debug("sort " << dirents.size() << " directory entries (url)");
-      std::sort(dirents.begin(), dirents.end(), compareUrl);
+      openClusters.push_back(OpenCluster());
+      OpenCluster& open = openClusters.back();
+      open.cluster.setCompression(group == uncompressedGroup ? zimcompNone : compression);
+      open.serial = nextSerial++;
+      open.group = group;
+      open.lastUse = ++useCounter;
+      return open;
+    }
+
+    uint32_t ZimCreator::clusterGroup(const Dirent& dirent, const Blob& blob) const
+    {
+      if (!dirent.isCompress())
+        return uncompressedGroup;
+
+      if (clusterGroups <= 1 || localityPlacement)
+        return 0;
 
+      uint32_t group = dirent.isArticle() ? uint32_t(dirent.getMimeType()) << 16 : 0xffff0000;
+      if (similarityBuckets > 0)
+        group |= minHash(blob.data(), blob.size()) % std::min(similarityBuckets, 0xffffu);
+
+      return group;
     }
 
-    namespace
+    void ZimCreator::addChecksumTable(ClusterWriter& clusterWriter)
     {
-      class CompareTitle
+      // the table is the only blob of the last cluster and covers all
+      // clusters before it
+      clusterWriter.flush();
+      const ClusterWriter::ChecksumsType& checksums = clusterWriter.getChecksums();
+      if (checksums.size() != clusterWriter.getClusterCount())
+        throw std::runtime_error("internal error: cluster checksum table does not cover all clusters");
+
+      std::string data((checksums.size() + 1) * sizeof(uint32_t), '\0');
+      toLittleEndian(static_cast<uint32_t>(checksums.size()), &data[0]);
+      for (ClusterWriter::ChecksumsType::size_type n = 0; n < checksums.size(); ++n)
+        toLittleEndian(checksums[n], &data[(n + 1) * sizeof(uint32_t)]);
+
+      Dirent dirent;
+      std::string url = Fileheader::checksumTableUrl;
+      dirent.setAid(std::string(1, Fileheader::checksumTableNamespace) + '/' + url);
+      dirent.setUrl(Fileheader::checksumTableNamespace, url);
+      dirent.setArticle(getMimeTypeIdx("application/octet-stream"), 0, 0);
+      dirents.push_back(dirent);
+      direntMemory += recordSize(dirent);
+
+      Cluster cluster;
+      cluster.setCompression(zimcompNone);
+      cluster.addBlob(data.data(), data.size());
+
+      DirentPtrsType clusterDirents(1, dirents.size() - 1);
+      closeCluster(clusterWriter, cluster, clusterDirents);
+
+      log_debug("checksum table of " << checksums.size() << " clusters added");
+    }
+
+    void ZimCreator::spillDirents(const std::string& tmpfname, OpenClusters& openClusters)
+    {
+      log_debug("spill " << dirents.size() << " directory entries; " << direntMemory << " bytes");
+
+      if (!direntSpill)
+        direntSpill = new DirentSpill(tmpfname + ".dirents", maxDirentMemory);
+
+      // The entries of the open clusters are kept, since they get their
+      // cluster number, when the cluster is closed.
+      std::vector<bool> pending(dirents.size());
+      DirentsType keep;
+      for (OpenClusters::iterator oc = openClusters.begin(); oc != openClusters.end(); ++oc)
       {
-          ZimCreator::DirentsType& dirents;
+        for (DirentPtrsType::iterator it = oc->dirents.begin(); it != oc->dirents.end(); ++it)
+        {
+          pending[*it] = true;
+          keep.push_back(dirents[*it]);
+          *it = keep.size() - 1;
+        }
+      }
 
-        public:
-          explicit CompareTitle(ZimCreator::DirentsType& dirents_)
-            : dirents(dirents_)
-            { }
-          bool operator() (size_type titleIdx1, size_type titleIdx2) const
-          {
-            Dirent d1 = dirents[titleIdx1];
-            Dirent d2 = dirents[titleIdx2];
-            return d1.getNamespace() < d2.getNamespace()
-               || (d1.getNamespace() == d2.getNamespace()
-                && d1.getTitle() < d2.getTitle());
-          }
-      };
+      for (DirentsType::size_type n = 0; n < dirents.size(); ++n)
+        if (!pending[n])
+          direntSpill->add(dirents[n]);
+
+      dirents.swap(keep);
+
+      direntMemory = 0;
+      for (DirentsType::const_iterator it = dirents.begin(); it != dirents.end(); ++it)
+        direntMemory += recordSize(*it);
     }
 
     void ZimCreator::createTitleIndex(ArticleSource& src)
     {
-      titleIdx.resize(dirents.size());
+      // the title index of spilled entries is created, when they are sorted
+      if (direntSpill)
+        return;
+
+      std::vector<TitleKey> keys;
+      keys.reserve(dirents.size());
       for (DirentsType::size_type n = 0; n < dirents.size(); ++n)
-        titleIdx[n] = dirents[n].getIdx();
+        keys.push_back(TitleKey(dirents[n], dirents[n].getIdx()));
 
-      CompareTitle compareTitle(dirents);
-      std::sort(titleIdx.begin(), titleIdx.end(), compareTitle);
+      parallelSort(keys.begin(), keys.end(), CompareTitle(dirents), sortThreads());
+
+      titleIdx.resize(keys.size());
+      for (std::vector<TitleKey>::size_type n = 0; n < keys.size(); ++n)
+        titleIdx[n] = keys[n].idx;
     }
 
     void ZimCreator::fillHeader(ArticleSource& src)
@@ -392,7 +1055,12 @@ namespace zim
       header.setMainPage(std::numeric_limits<size_type>::max());
       header.setLayoutPage(std::numeric_limits<size_type>::max());
 
-      if (!mainAid.empty() || !layoutAid.empty())
+      if (direntSpill)
+      {
+        header.setMainPage(direntSpill->getMainIdx());
+        header.setLayoutPage(direntSpill->getLayoutIdx());
+      }
+      else if (!mainAid.empty() || !layoutAid.empty())
       {
         for (DirentsType::const_iterator di = dirents.begin(); di != dirents.end(); ++di)
         {
@@ -411,13 +1079,9 @@ namespace zim
       }
 
       header.setUuid( src.getUuid() );
-      header.setArticleCount( dirents.size() );
-      header.setUrlPtrPos( urlPtrPos() );
-      header.setMimeListPos( mimeListPos() );
-      header.setTitleIdxPos( titleIdxPos() );
+      header.setArticleCount( articleCount() );
       header.setClusterCount( clusterOffsets.size() );
-      header.setClusterPtrPos( clusterPtrPos() );
-      header.setChecksumPos( checksumPos() );
+      setHeaderPositions();
 
       log_debug(
             "mimeListSize=" << mimeListSize() <<
@@ -430,7 +1094,6 @@ namespace zim
            " clusterPtrPos=" << clusterPtrPos() <<
            " clusterCount=" << clusterCount() <<
            " articleCount=" << articleCount() <<
-           " articleCount=" << dirents.size() <<
            " urlPtrPos=" << header.getUrlPtrPos() <<
            " titleIdxPos=" << header.getTitleIdxPos() <<
            " clusterCount=" << header.getClusterCount() <<
@@ -439,17 +1102,18 @@ namespace zim
            );
     }
 
-    void ZimCreator::write(const std::string& fname, const std::string& tmpfname)
+    void ZimCreator::setHeaderPositions()
     {
-      std::ofstream zimfile(fname.c_str());
-      Md5stream md5;
-      Tee out(zimfile, md5);
-
-      out << header;
-
-      log_debug("after writing header - pos=" << zimfile.tellp());
+      header.setUrlPtrPos( urlPtrPos() );
+      header.setMimeListPos( mimeListPos() );
+      header.setTitleIdxPos( titleIdxPos() );
+      header.setClusterPtrPos( clusterPtrPos() );
+      header.setChecksumPos( checksumPos() );
+    }
 
-      // write mime type list
+    void ZimCreator::write(const std::string& fname, const std::string& tmpfname)
+    {
+      // sort the mime type list and renumber the mime types of the entries
       std::vector<std::string> oldMImeList;
       std::vector<std::string> newMImeList;
       std::vector<uint16_t> mapping;
@@ -478,21 +1142,117 @@ namespace zim
           dirents[i].setMimeType(mapping[dirents[i].getMimeType()]);
       }
 
-      for (unsigned i=0; i<newMImeList.size(); ++i)
+      if (isEmpty)
+        log_warn("no data found");
+
+      if (directoryFirst)
+        writeClassic(fname, tmpfname, newMImeList, mapping);
+      else
+        writeDirect(fname, newMImeList, mapping);
+    }
+
+    // In the classic layout the file is written from start to end, so the
+    // md5 sum is calculated while writing. The clusters are copied from the
+    // temporary file behind the directory.
+    void ZimCreator::writeClassic(const std::string& fname, const std::string& tmpfname,
+                                  const std::vector<std::string>& mimeList,
+                                  const std::vector<uint16_t>& mapping)
+    {
+      std::ofstream zimfile(fname.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+      if (!zimfile)
+        throw std::runtime_error("failed to open zimfile " + fname);
+
+      Md5Writer out(zimfile);
+
+      out << header;
+
+      log_debug("after writing header - pos=" << out.tellp());
+
+      for (unsigned i=0; i<mimeList.size(); ++i)
+        out << mimeList[i] << '\0';
+      out << '\0';
+
+      writeDirectory(out, mapping);
+
+      if (clustersSize > 0)
       {
-        out << newMImeList[i] << '\0';
+        log_debug("copy " << clustersSize << " bytes of cluster data to pos=" << clustersPos());
+
+        std::ifstream clusters(tmpfname.c_str(), std::ios::in | std::ios::binary);
+        clusters.seekg(tmpClustersPos);
+        std::vector<char> buffer(1024 * 1024);
+        offset_type remaining = clustersSize;
+        while (remaining > 0)
+        {
+          std::streamsize count = remaining < buffer.size() ? remaining : buffer.size();
+          if (!clusters.read(&buffer[0], count))
+            throw std::runtime_error("unexpected end of temporary cluster file");
+          out.write(&buffer[0], count);
+          remaining -= count;
+        }
       }
 
-      out << '\0';
+      out.flush();
+      if (!out)
+        throw std::runtime_error("failed to write zimfile");
 
+      log_debug("after writing clusterData - pos=" << out.tellp());
+
+      unsigned char digest[16];
+      out.getDigest(digest);
+      zimfile.write(reinterpret_cast<const char*>(digest), 16);
+      zimfile.close();
+      if (zimfile.fail())
+        throw std::runtime_error("failed to write zimfile");
+    }
+
+    // In the direct layout the clusters are already in the zim file. The
+    // directory is appended and the header is written into the reserved
+    // space at the start. The md5 sum is calculated afterwards by
+    // writeChecksum.
+    void ZimCreator::writeDirect(const std::string& fname,
+                                 const std::vector<std::string>& mimeList,
+                                 const std::vector<uint16_t>& mapping)
+    {
+      std::fstream zimfile(fname.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+      if (!zimfile)
+        throw std::runtime_error("failed to open zimfile " + fname);
+
+      zimfile.seekp(urlPtrPos());
+      writeDirectory(zimfile, mapping);
+      zimfile.seekp(0);
+
+      zimfile << header;
+
+      log_debug("after writing header - pos=" << zimfile.tellp());
+
+      for (unsigned i=0; i<mimeList.size(); ++i)
+        zimfile << mimeList[i] << '\0';
+      zimfile << '\0';
+
+      zimfile.close();
+      if (zimfile.fail())
+        throw std::runtime_error("failed to write zimfile");
+    }
+
+    void ZimCreator::writeDirectory(std::ostream& out, const std::vector<uint16_t>& mimeMapping)
+    {
       // write url ptr list
 
       offset_type off = indexPos();
-      for (DirentsType::const_iterator it = dirents.begin(); it != dirents.end(); ++it)
+      if (direntSpill)
       {
-        offset_type ptr0 = fromLittleEndian<offset_type>(&off);
-        out.write(reinterpret_cast<const char*>(&ptr0), sizeof(ptr0));
-        off += it->getDirentSize();
+        direntSpill->writeUrlPtrs(out, off);
+        off += indexSize();
+      }
+      else
+      {
+        for (DirentsType::const_iterator it = dirents.begin(); it != dirents.end(); ++it)
+        {
+          offset_type ptr0 = fromLittleEndian<offset_type>(&off);
+          out.write(reinterpret_cast<const char*>(&ptr0), sizeof(ptr0));
+          off += it->getDirentSize();
+        }
       }
 
       log_debug("after writing direntPtr - pos=" << out.tellp());
@@ -509,6 +1269,9 @@ namespace zim
 
       // write directory entries
 
+      if (direntSpill)
+        direntSpill->writeDirents(out, mimeMapping);
+
       for (DirentsType::const_iterator it = dirents.begin(); it != dirents.end(); ++it)
       {
         out << *it;
@@ -519,33 +1282,45 @@ namespace zim
 
       // write cluster offset list
 
-      off += clusterOffsets.size() * sizeof(offset_type);
       for (OffsetsType::const_iterator it = clusterOffsets.begin(); it != clusterOffsets.end(); ++it)
       {
-        offset_type o = (off + *it);
+        offset_type o = clustersPos() + *it;
         offset_type ptr0 = fromLittleEndian<offset_type>(&o);
         out.write(reinterpret_cast<const char*>(&ptr0), sizeof(ptr0));
       }
 
       log_debug("after writing clusterOffsets - pos=" << out.tellp());
+    }
 
-      // write cluster data
-
-      if (!isEmpty)
+    void ZimCreator::writeChecksum(const std::string& fname)
+    {
+      // In the direct layout the header is written last, so the sum is
+      // calculated by reading the file again. This costs a read pass over
+      // the archive, which the classic layout avoids; in exchange the
+      // clusters are not copied from a temporary file. The hashing runs in
+      // the background while reading.
+      std::fstream zimfile(fname.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+      Md5Writer md5;
+
+      std::vector<char> buffer(1024 * 1024);
+      offset_type remaining = checksumPos();
+      while (remaining > 0)
       {
-        std::ifstream blobsfile(tmpfname.c_str());
-        out << blobsfile.rdbuf();
+        std::streamsize count = remaining < buffer.size() ? remaining : buffer.size();
+        if (!zimfile.read(&buffer[0], count))
+          throw std::runtime_error("failed to read zimfile " + fname);
+        md5.write(&buffer[0], count);
+        remaining -= count;
       }
-      else
-        log_warn("no data found");
 
-      if (!out)
-        throw std::runtime_error("failed to write zimfile");
-
-      log_debug("after writing clusterData - pos=" << out.tellp());
       unsigned char digest[16];
       md5.getDigest(digest);
+
+      zimfile.seekp(checksumPos());
       zimfile.write(reinterpret_cast<const char*>(digest), 16);
+      zimfile.close();
+      if (zimfile.fail())
+        throw std::runtime_error("failed to write checksum");
     }
 
     offset_type ZimCreator::mimeListSize() const
@@ -556,8 +1331,16 @@ namespace zim
       return ret;
     }
 
+    size_type ZimCreator::articleCount() const
+    {
+      return direntSpill ? direntSpill->getArticleCount() : dirents.size();
+    }
+
     offset_type ZimCreator::indexSize() const
     {
+      if (direntSpill)
+        return direntSpill->getDirentsSize();
+
       offset_type s = 0;
 
       for (DirentsType::const_iterator it = dirents.begin(); it != dirents.end(); ++it)
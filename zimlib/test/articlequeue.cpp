@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "articlequeue.h"
+#include <zim/blob.h>
+#include <zim/mutex.h>
+#include <stdexcept>
+#include <string>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  class TestArticle : public zim::writer::Article
+  {
+      std::string url;
+      std::string data;
+
+    public:
+      TestArticle(const std::string& url_, const std::string& data_)
+        : url(url_),
+          data(data_)
+          { }
+
+      virtual std::string getAid() const        { return url; }
+      virtual char getNamespace() const         { return 'A'; }
+      virtual std::string getUrl() const        { return url; }
+      virtual std::string getTitle() const      { return url; }
+      virtual std::string getMimeType() const   { return "text/plain"; }
+      virtual zim::Blob getData() const         { return zim::Blob(data.data(), data.size()); }
+  };
+
+  // Pushes articles into the queue in a separate thread and counts the
+  // articles, which are accepted.
+  class Producer
+  {
+      zim::writer::ArticleQueue& queue;
+      unsigned count;
+      unsigned dataSize;
+
+      zim::Mutex mutex;
+      unsigned pushed;
+      bool finished;
+      std::string error;
+
+      pthread_t thread;
+
+      static void* threadStart(void* arg)
+      {
+        static_cast<Producer*>(arg)->run();
+        return 0;
+      }
+
+      void run()
+      {
+        try
+        {
+          for (unsigned n = 0; n < count; ++n)
+          {
+            queue.push(TestArticle(std::string(1, 'a' + n % 26), std::string(dataSize, 'x')));
+            zim::MutexLock lock(mutex);
+            ++pushed;
+          }
+        }
+        catch (const std::exception& e)
+        {
+          zim::MutexLock lock(mutex);
+          error = e.what();
+        }
+
+        zim::MutexLock lock(mutex);
+        finished = true;
+      }
+
+    public:
+      Producer(zim::writer::ArticleQueue& queue_, unsigned count_, unsigned dataSize_)
+        : queue(queue_),
+          count(count_),
+          dataSize(dataSize_),
+          pushed(0),
+          finished(false)
+      {
+        pthread_create(&thread, 0, threadStart, this);
+      }
+
+      ~Producer()
+      {
+        pthread_join(thread, 0);
+      }
+
+      unsigned getPushed()
+      {
+        zim::MutexLock lock(mutex);
+        return pushed;
+      }
+
+      bool isFinished()
+      {
+        zim::MutexLock lock(mutex);
+        return finished;
+      }
+
+      std::string getError()
+      {
+        zim::MutexLock lock(mutex);
+        return error;
+      }
+
+      // Waits up to 5 seconds until the producer has pushed the given number
+      // of articles or has finished.
+      void waitPushed(unsigned n)
+      {
+        for (unsigned i = 0; i < 500 && getPushed() < n && !isFinished(); ++i)
+          ::usleep(10000);
+      }
+
+      void waitFinished()
+      {
+        for (unsigned i = 0; i < 500 && !isFinished(); ++i)
+          ::usleep(10000);
+      }
+  };
+}
+
+class ArticleQueueTest : public cxxtools::unit::TestSuite
+{
+  public:
+    ArticleQueueTest()
+      : cxxtools::unit::TestSuite("zim::ArticleQueueTest")
+    {
+      registerMethod("Order", *this, &ArticleQueueTest::Order);
+      registerMethod("LimitArticles", *this, &ArticleQueueTest::LimitArticles);
+      registerMethod("LimitBytes", *this, &ArticleQueueTest::LimitBytes);
+      registerMethod("LargeArticle", *this, &ArticleQueueTest::LargeArticle);
+      registerMethod("Close", *this, &ArticleQueueTest::Close);
+      registerMethod("Error", *this, &ArticleQueueTest::Error);
+    }
+
+    void Order()
+    {
+      zim::writer::ArticleQueue queue(10, 1000, "main", "layout");
+      queue.push(TestArticle("a", "first"));
+      queue.push(TestArticle("b", "second"));
+      queue.close();
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(queue.getMainPage(), "main");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(queue.getLayoutPage(), "layout");
+
+      const zim::writer::Article* a = queue.getNextArticle();
+      CXXTOOLS_UNIT_ASSERT(a != 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(a->getUrl(), "a");
+      zim::Blob b = a->getData();
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(b.data(), b.size()), "first");
+
+      a = queue.getNextArticle();
+      CXXTOOLS_UNIT_ASSERT(a != 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(a->getUrl(), "b");
+
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() == 0);
+    }
+
+    void LimitArticles()
+    {
+      zim::writer::ArticleQueue queue(3, 1000000, "", "");
+      Producer producer(queue, 5, 10);
+
+      producer.waitPushed(3);
+      ::usleep(50000);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getPushed(), 3);
+
+      // each article taken makes room for the next
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() != 0);
+      producer.waitPushed(4);
+      ::usleep(50000);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getPushed(), 4);
+
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() != 0);
+      producer.waitFinished();
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getPushed(), 5);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getError(), "");
+
+      queue.close();
+      for (unsigned n = 0; n < 3; ++n)
+        CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() != 0);
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() == 0);
+    }
+
+    void LimitBytes()
+    {
+      // 2 articles of 40 bytes fit into 100 bytes
+      zim::writer::ArticleQueue queue(100, 100, "", "");
+      Producer producer(queue, 4, 40);
+
+      producer.waitPushed(2);
+      ::usleep(50000);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getPushed(), 2);
+
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() != 0);
+      producer.waitPushed(3);
+      ::usleep(50000);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getPushed(), 3);
+
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() != 0);
+      producer.waitFinished();
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getPushed(), 4);
+      queue.close();
+    }
+
+    void LargeArticle()
+    {
+      // an article larger than the limit is accepted into an empty queue
+      zim::writer::ArticleQueue queue(100, 100, "", "");
+      queue.push(TestArticle("a", std::string(1000, 'x')));
+      queue.close();
+
+      const zim::writer::Article* a = queue.getNextArticle();
+      CXXTOOLS_UNIT_ASSERT(a != 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(a->getData().size(), 1000);
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() == 0);
+    }
+
+    void Close()
+    {
+      zim::writer::ArticleQueue queue(2, 1000000, "", "");
+      Producer producer(queue, 3, 10);
+      producer.waitPushed(2);
+
+      // a blocked producer fails, when the queue is closed, but the
+      // articles already queued are returned
+      queue.close();
+      producer.waitFinished();
+      CXXTOOLS_UNIT_ASSERT(producer.isFinished());
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getPushed(), 2);
+      CXXTOOLS_UNIT_ASSERT(!producer.getError().empty());
+
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() != 0);
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() != 0);
+      CXXTOOLS_UNIT_ASSERT(queue.getNextArticle() == 0);
+
+      CXXTOOLS_UNIT_ASSERT_THROW(queue.push(TestArticle("a", "data")), std::runtime_error);
+    }
+
+    void Error()
+    {
+      zim::writer::ArticleQueue queue(2, 1000000, "", "");
+      Producer producer(queue, 3, 10);
+      producer.waitPushed(2);
+
+      queue.setError("creator failed");
+      producer.waitFinished();
+      CXXTOOLS_UNIT_ASSERT(producer.isFinished());
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getPushed(), 2);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(producer.getError(), "creator failed");
+
+      CXXTOOLS_UNIT_ASSERT_THROW(queue.push(TestArticle("a", "data")), std::runtime_error);
+      queue.close();
+    }
+
+};
+
+cxxtools::unit::RegisterTest<ArticleQueueTest> register_ArticleQueueTest;
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "blockreader.h"
+#include <zim/fstream.h>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  std::string testData(unsigned size)
+  {
+    std::string data;
+    for (unsigned n = 0; n < size; ++n)
+      data += static_cast<char>(n * 13 + n / 256);
+    return data;
+  }
+
+  // Appends all blocks of the range to ret and checks their sizes.
+  void readAll(zim::BlockReader& reader, unsigned blockSize, std::string& ret)
+  {
+    unsigned count;
+    const char* data;
+    while ((data = reader.next(count)) != 0)
+    {
+      CXXTOOLS_UNIT_ASSERT(count > 0);
+      CXXTOOLS_UNIT_ASSERT(count <= blockSize);
+      ret.append(data, count);
+    }
+    CXXTOOLS_UNIT_ASSERT_EQUALS(count, 0);
+  }
+}
+
+class BlockReaderTest : public cxxtools::unit::TestSuite
+{
+    std::string name;
+    std::string data;
+
+  public:
+    BlockReaderTest()
+      : cxxtools::unit::TestSuite("zim::BlockReaderTest")
+    {
+      registerMethod("ReadRange", *this, &BlockReaderTest::ReadRange);
+      registerMethod("ReadBlocks", *this, &BlockReaderTest::ReadBlocks);
+      registerMethod("ReadEmpty", *this, &BlockReaderTest::ReadEmpty);
+      registerMethod("ReadTruncated", *this, &BlockReaderTest::ReadTruncated);
+    }
+
+    void setUp()
+    {
+      name = std::tmpnam(NULL);
+      data = testData(100000);
+      std::ofstream os(name.c_str());
+      os << data;
+    }
+
+    void tearDown()
+    {
+      std::remove(name.c_str());
+    }
+
+    void ReadRange()
+    {
+      // the range is not a multiple of the block size
+      zim::ifstream in(name);
+      zim::BlockReader reader(in, 123, 54321, 1000);
+      std::string result;
+      readAll(reader, 1000, result);
+      CXXTOOLS_UNIT_ASSERT(result == data.substr(123, 54321));
+    }
+
+    void ReadBlocks()
+    {
+      // the range ends exactly at the end of a block and of the file
+      zim::ifstream in(name);
+      zim::BlockReader reader(in, 0, data.size(), 10000);
+      std::string result;
+      readAll(reader, 10000, result);
+      CXXTOOLS_UNIT_ASSERT(result == data);
+    }
+
+    void ReadEmpty()
+    {
+      zim::ifstream in(name);
+      zim::BlockReader reader(in, 10, 0, 1000);
+      unsigned count = 1;
+      CXXTOOLS_UNIT_ASSERT(reader.next(count) == 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(count, 0);
+    }
+
+    void ReadTruncated()
+    {
+      // the range extends beyond the end of the file
+      zim::ifstream in(name);
+      zim::BlockReader reader(in, 90000, 20000, 1000);
+      std::string result;
+      CXXTOOLS_UNIT_ASSERT_THROW(readAll(reader, 1000, result), std::runtime_error);
+
+      // the data up to the end of the file is returned before the error
+      CXXTOOLS_UNIT_ASSERT(result == data.substr(90000));
+    }
+
+};
+
+cxxtools::unit::RegisterTest<BlockReaderTest> register_BlockReaderTest;
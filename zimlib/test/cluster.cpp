@@ -18,6 +18,7 @@
  */
 
 #include <zim/cluster.h>
+#include <zim/blob.h>
 #include <zim/fstream.h>
 #include <zim/zim.h>
 #include <sstream>
@@ -39,6 +40,9 @@ class ClusterTest : public cxxtools::unit::TestSuite
       registerMethod("CreateCluster", *this, &ClusterTest::CreateCluster);
       registerMethod("ReadWriteCluster", *this, &ClusterTest::ReadWriteCluster);
       registerMethod("ReadWriteEmpty", *this, &ClusterTest::ReadWriteEmpty);
+      registerMethod("BlobCopyThreshold", *this, &ClusterTest::BlobCopyThreshold);
+      registerMethod("BlobRange", *this, &ClusterTest::BlobRange);
+      registerMethod("BlobRangeFromFile", *this, &ClusterTest::BlobRangeFromFile);
 #ifdef ENABLE_ZLIB
       registerMethod("ReadWriteClusterZ", *this, &ClusterTest::ReadWriteClusterZ);
 #endif
@@ -100,6 +104,84 @@ class ClusterTest : public cxxtools::unit::TestSuite
       std::remove(name.c_str());
     }
 
+    void BlobCopyThreshold()
+    {
+      zim::Cluster cluster;
+
+      std::string blob0("123456789012345678901234567890");
+      std::string blob1("ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+
+      cluster.addBlob(blob0.data(), blob0.size());
+      cluster.addBlob(blob1.data(), blob1.size());
+
+      zim::size_type threshold = zim::Cluster::getBlobCopyThreshold();
+
+      zim::Cluster::setBlobCopyThreshold(0);
+      zim::Blob b = cluster.getBlob(0);
+      CXXTOOLS_UNIT_ASSERT(b.data() == cluster.getBlobPtr(0));
+
+      zim::Cluster::setBlobCopyThreshold(100);
+      zim::Blob c = cluster.getBlob(0);
+      CXXTOOLS_UNIT_ASSERT(c.data() != cluster.getBlobPtr(0));
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(c.data(), c.size()), blob0);
+
+      zim::Cluster::setBlobCopyThreshold(threshold);
+    }
+
+    void BlobRange()
+    {
+      zim::Cluster cluster;
+
+      std::string blob0("123456789012345678901234567890");
+      std::string blob1("ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+
+      cluster.addBlob(blob0.data(), blob0.size());
+      cluster.addBlob(blob1.data(), blob1.size());
+
+      zim::Blob b = cluster.getBlob(1, 3, 5);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(b.data(), b.size()), "DEFGH");
+
+      b = cluster.getBlob(1, 20, 100);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(b.data(), b.size()), "UVWXYZ");
+
+      b = cluster.getBlob(1, 26, 1);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(b.size(), 0);
+    }
+
+    void BlobRangeFromFile()
+    {
+      std::string name = std::tmpnam(NULL);
+      std::ofstream os;
+      os.open(name.c_str());
+
+      zim::Cluster cluster;
+
+      std::string blob0("123456789012345678901234567890");
+      std::string blob1("ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+
+      cluster.addBlob(blob0.data(), blob0.size());
+      cluster.addBlob(blob1.data(), blob1.size());
+
+      os << "xyz" << cluster;
+      os.close();
+
+      zim::ifstream is(name);
+      zim::Cluster cluster2;
+      cluster2.init_from_stream(is, 3);
+      CXXTOOLS_UNIT_ASSERT(!is.fail());
+
+      zim::Blob b = cluster2.getBlob(1, 3, 5);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(b.data(), b.size()), "DEFGH");
+
+      b = cluster2.getBlob(0, 25, 10);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(b.data(), b.size()), "67890");
+
+      b = cluster2.getBlob(1, 30, 1);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(b.size(), 0);
+
+      std::remove(name.c_str());
+    }
+
     void ReadWriteEmpty()
     {
       std::string name = std::tmpnam(NULL);
@@ -144,7 +226,16 @@ class ClusterTest : public cxxtools::unit::TestSuite
       cluster.addBlob(blob2.data(), blob2.size());
       cluster.setCompression(zim::zimcompZip);
 
+      // a second cluster right behind the first must be readable, so the
+      // compressed stream of the first has to be complete
+      zim::Cluster cluster1;
+      std::string blob3("second cluster");
+      cluster1.addBlob(blob3.data(), blob3.size());
+      cluster1.setCompression(zim::zimcompZip);
+
       os << cluster;
+      zim::offset_type offset1 = os.tellp();
+      os << cluster1;
       os.close();
 
       zim::ifstream is(name);
@@ -159,6 +250,14 @@ class ClusterTest : public cxxtools::unit::TestSuite
       CXXTOOLS_UNIT_ASSERT(std::equal(cluster2.getBlobPtr(0), cluster2.getBlobPtr(0) + cluster2.getBlobSize(0), blob0.data()));
       CXXTOOLS_UNIT_ASSERT(std::equal(cluster2.getBlobPtr(1), cluster2.getBlobPtr(1) + cluster2.getBlobSize(1), blob1.data()));
       CXXTOOLS_UNIT_ASSERT(std::equal(cluster2.getBlobPtr(2), cluster2.getBlobPtr(2) + cluster2.getBlobSize(2), blob2.data()));
+
+      zim::Cluster cluster3;
+      cluster3.init_from_stream(is, offset1);
+      CXXTOOLS_UNIT_ASSERT(!is.fail());
+      CXXTOOLS_UNIT_ASSERT_EQUALS(cluster3.count(), 1);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(cluster3.getCompression(), zim::zimcompZip);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(cluster3.getBlobSize(0), blob3.size());
+      CXXTOOLS_UNIT_ASSERT(std::equal(cluster3.getBlobPtr(0), cluster3.getBlobPtr(0) + cluster3.getBlobSize(0), blob3.data()));
       std::remove(name.c_str());
     }
 
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "clusterwriter.h"
+#include "crc32c.h"
+#include "config.h"
+#include <zim/blob.h>
+#include <zim/fstream.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  std::string blobData(unsigned n)
+  {
+    std::ostringstream s;
+    s << "blob " << n << ' ';
+    for (unsigned i = 0; i < n % 50; ++i)
+      s << "data " << i * n << ' ';
+    return s.str();
+  }
+
+  zim::Cluster makeCluster(unsigned n)
+  {
+    zim::Cluster cluster;
+    std::string b0 = blobData(n);
+    std::string b1 = blobData(n + 1000);
+    cluster.addBlob(b0.data(), b0.size());
+    cluster.addBlob(b1.data(), b1.size());
+#ifdef ENABLE_ZLIB
+    cluster.setCompression(n % 2 ? zim::zimcompNone : zim::zimcompZip);
+#endif
+    return cluster;
+  }
+
+  // Checks, that the clusters written to data are in order, start at the
+  // offsets and have the checksums.
+  void checkClusters(const std::string& data, const zim::ClusterWriter& writer, unsigned count)
+  {
+    std::string name = std::tmpnam(NULL);
+    std::ofstream os(name.c_str());
+    os << data;
+    os.close();
+    zim::ifstream in(name);
+
+    const zim::ClusterWriter::OffsetsType& offsets = writer.getOffsets();
+    const zim::ClusterWriter::ChecksumsType& checksums = writer.getChecksums();
+
+    CXXTOOLS_UNIT_ASSERT_EQUALS(offsets.size(), count);
+    CXXTOOLS_UNIT_ASSERT_EQUALS(checksums.size(), count);
+
+    for (unsigned n = 0; n < count; ++n)
+    {
+      zim::offset_type end = n + 1 < count ? offsets[n + 1] : data.size();
+      CXXTOOLS_UNIT_ASSERT(offsets[n] < end);
+
+      zim::Cluster cluster;
+      cluster.init_from_stream(in, offsets[n]);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(cluster.count(), 2);
+
+      zim::Blob b = cluster.getBlob(0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(b.data(), b.size()), blobData(n));
+      b = cluster.getBlob(1);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(b.data(), b.size()), blobData(n + 1000));
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(checksums[n],
+        zim::crc32c(0, data.data() + offsets[n], end - offsets[n]));
+    }
+
+    std::remove(name.c_str());
+  }
+}
+
+class ClusterWriterTest : public cxxtools::unit::TestSuite
+{
+  public:
+    ClusterWriterTest()
+      : cxxtools::unit::TestSuite("zim::ClusterWriterTest")
+    {
+      registerMethod("WriteNoThreads", *this, &ClusterWriterTest::WriteNoThreads);
+      registerMethod("WriteThreads", *this, &ClusterWriterTest::WriteThreads);
+      registerMethod("FlushThreads", *this, &ClusterWriterTest::FlushThreads);
+    }
+
+    void WriteNoThreads()
+    {
+      std::ostringstream out;
+      zim::ClusterWriter writer(out, 0);
+      writer.setChecksums(true);
+
+      for (unsigned n = 0; n < 20; ++n)
+        CXXTOOLS_UNIT_ASSERT_EQUALS(writer.add(makeCluster(n)), n);
+      writer.finish();
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(writer.getWrittenSize(), out.str().size());
+      checkClusters(out.str(), writer, 20);
+    }
+
+    void WriteThreads()
+    {
+      std::ostringstream out;
+      out << "head";
+      zim::ClusterWriter writer(out, 4);
+      writer.setChecksums(true);
+
+      for (unsigned n = 0; n < 200; ++n)
+        CXXTOOLS_UNIT_ASSERT_EQUALS(writer.add(makeCluster(n)), n);
+      writer.finish();
+
+      std::string data = out.str();
+      CXXTOOLS_UNIT_ASSERT_EQUALS(writer.getOffsets()[0], 4);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(writer.getWrittenSize() + 4, data.size());
+      checkClusters(data, writer, 200);
+    }
+
+    void FlushThreads()
+    {
+      // after each flush all clusters added so far must be written
+      std::ostringstream out;
+      zim::ClusterWriter writer(out, 4, 2);
+      writer.setChecksums(true);
+
+      unsigned count = 0;
+      for (unsigned round = 0; round < 50; ++round)
+      {
+        for (unsigned n = 0; n < 5; ++n)
+          writer.add(makeCluster(count++));
+        writer.flush();
+
+        CXXTOOLS_UNIT_ASSERT_EQUALS(writer.getOffsets().size(), count);
+        CXXTOOLS_UNIT_ASSERT_EQUALS(writer.getChecksums().size(), count);
+        CXXTOOLS_UNIT_ASSERT_EQUALS(writer.getWrittenSize(), out.str().size());
+      }
+
+      writer.finish();
+      checkClusters(out.str(), writer, count);
+    }
+
+};
+
+cxxtools::unit::RegisterTest<ClusterWriterTest> register_ClusterWriterTest;
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "crc32c.h"
+#include <string>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  // bitwise calculation as reference
+  uint32_t crc32cReference(const char* data, std::size_t size)
+  {
+    uint32_t crc = 0xffffffff;
+    for (std::size_t n = 0; n < size; ++n)
+    {
+      crc ^= static_cast<unsigned char>(data[n]);
+      for (unsigned k = 0; k < 8; ++k)
+        crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+    }
+    return ~crc;
+  }
+}
+
+class Crc32cTest : public cxxtools::unit::TestSuite
+{
+  public:
+    Crc32cTest()
+      : cxxtools::unit::TestSuite("zim::Crc32cTest")
+    {
+      registerMethod("CheckValue", *this, &Crc32cTest::CheckValue);
+      registerMethod("Empty", *this, &Crc32cTest::Empty);
+      registerMethod("Continue", *this, &Crc32cTest::Continue);
+      registerMethod("Unaligned", *this, &Crc32cTest::Unaligned);
+    }
+
+    void CheckValue()
+    {
+      CXXTOOLS_UNIT_ASSERT_EQUALS(zim::crc32c(0, "123456789", 9), 0xE3069283);
+    }
+
+    void Empty()
+    {
+      CXXTOOLS_UNIT_ASSERT_EQUALS(zim::crc32c(0, "", 0), 0);
+    }
+
+    void Continue()
+    {
+      uint32_t crc = zim::crc32c(0, "1234", 4);
+      crc = zim::crc32c(crc, "56789", 5);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(crc, 0xE3069283);
+    }
+
+    void Unaligned()
+    {
+      std::string data;
+      for (unsigned n = 0; n < 1000; ++n)
+        data += static_cast<char>(n * 7 + 3);
+
+      for (unsigned off = 0; off < 9; ++off)
+        for (unsigned size = 0; size < 40; ++size)
+          CXXTOOLS_UNIT_ASSERT_EQUALS(zim::crc32c(0, data.data() + off, size),
+                                      crc32cReference(data.data() + off, size));
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(zim::crc32c(0, data.data() + 3, 997),
+                                  crc32cReference(data.data() + 3, 997));
+    }
+
+};
+
+cxxtools::unit::RegisterTest<Crc32cTest> register_Crc32cTest;
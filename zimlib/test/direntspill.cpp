@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "direntspill.h"
+#include <limits>
+#include <sstream>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  zim::writer::Dirent article(const std::string& url, const std::string& aid)
+  {
+    zim::writer::Dirent dirent('A', url);
+    dirent.setAid(aid);
+    dirent.setArticle(0, 0, 0);
+    return dirent;
+  }
+
+  zim::writer::Dirent redirect(const std::string& url, const std::string& aid,
+                               const std::string& redirectAid)
+  {
+    zim::writer::Dirent dirent('A', url);
+    dirent.setAid(aid);
+    dirent.setRedirect(0);
+    dirent.setRedirectAid(redirectAid);
+    return dirent;
+  }
+}
+
+class DirentSpillTest : public cxxtools::unit::TestSuite
+{
+  public:
+    DirentSpillTest()
+      : cxxtools::unit::TestSuite("zim::DirentSpillTest")
+    {
+      registerMethod("RemoveInvalidRedirects", *this, &DirentSpillTest::RemoveInvalidRedirects);
+      registerMethod("RedirectToRemovedRedirect", *this, &DirentSpillTest::RedirectToRemovedRedirect);
+      registerMethod("FinishSpilled", *this, &DirentSpillTest::FinishSpilled);
+    }
+
+    void RemoveInvalidRedirects()
+    {
+      using zim::writer::notRedirect;
+      using zim::writer::missingTarget;
+
+      std::vector<zim::size_type> redirectIdx;
+      redirectIdx.push_back(notRedirect);
+      redirectIdx.push_back(missingTarget);
+      redirectIdx.push_back(3);
+      redirectIdx.push_back(notRedirect);
+
+      std::vector<bool> removed;
+      std::vector<zim::size_type> idx;
+      zim::size_type n = zim::writer::removeInvalidRedirects(redirectIdx, removed, idx);
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(n, 3);
+      CXXTOOLS_UNIT_ASSERT(!removed[0]);
+      CXXTOOLS_UNIT_ASSERT(removed[1]);
+      CXXTOOLS_UNIT_ASSERT(!removed[2]);
+      CXXTOOLS_UNIT_ASSERT(!removed[3]);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(idx[0], 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(idx[2], 1);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(idx[3], 2);
+
+      // the redirect points to the index of its target after removal
+      CXXTOOLS_UNIT_ASSERT_EQUALS(redirectIdx[2], 2);
+    }
+
+    void RedirectToRemovedRedirect()
+    {
+      using zim::writer::notRedirect;
+      using zim::writer::missingTarget;
+
+      // 0 -> 2 -> 3 -> missing; 1 -> 4 (article)
+      std::vector<zim::size_type> redirectIdx;
+      redirectIdx.push_back(2);
+      redirectIdx.push_back(4);
+      redirectIdx.push_back(3);
+      redirectIdx.push_back(missingTarget);
+      redirectIdx.push_back(notRedirect);
+
+      std::vector<bool> removed;
+      std::vector<zim::size_type> idx;
+      zim::size_type n = zim::writer::removeInvalidRedirects(redirectIdx, removed, idx);
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(n, 2);
+      CXXTOOLS_UNIT_ASSERT(removed[0]);
+      CXXTOOLS_UNIT_ASSERT(!removed[1]);
+      CXXTOOLS_UNIT_ASSERT(removed[2]);
+      CXXTOOLS_UNIT_ASSERT(removed[3]);
+      CXXTOOLS_UNIT_ASSERT(!removed[4]);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(redirectIdx[1], 1);
+    }
+
+    void FinishSpilled()
+    {
+      // a memory limit of 1 byte writes each entry to a run of its own
+      zim::writer::DirentSpill spill("direntspill-test", 1);
+      spill.add(redirect("e", "5", "4"));
+      spill.add(article("b", "2"));
+      spill.add(redirect("d", "4", "9"));
+      spill.add(redirect("c", "3", "2"));
+      spill.add(article("a", "1"));
+
+      std::vector<zim::size_type> titleIdx;
+      spill.finish("3", "5", titleIdx);
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(spill.getArticleCount(), 3);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(titleIdx.size(), 3);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(titleIdx[0], 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(titleIdx[1], 1);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(titleIdx[2], 2);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(spill.getMainIdx(), 2);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(spill.getLayoutIdx(), std::numeric_limits<zim::size_type>::max());
+
+      std::vector<uint16_t> mimeMapping(1, 0);
+      std::stringstream s;
+      spill.writeDirents(s, mimeMapping);
+
+      zim::Dirent dirent;
+      s >> dirent;
+      CXXTOOLS_UNIT_ASSERT_EQUALS(dirent.getUrl(), "a");
+      s >> dirent;
+      CXXTOOLS_UNIT_ASSERT_EQUALS(dirent.getUrl(), "b");
+      s >> dirent;
+      CXXTOOLS_UNIT_ASSERT_EQUALS(dirent.getUrl(), "c");
+      CXXTOOLS_UNIT_ASSERT(dirent.isRedirect());
+      CXXTOOLS_UNIT_ASSERT_EQUALS(dirent.getRedirectIndex(), 1);
+      CXXTOOLS_UNIT_ASSERT(!s.fail());
+      CXXTOOLS_UNIT_ASSERT(s.peek() == std::istream::traits_type::eof());
+    }
+
+};
+
+cxxtools::unit::RegisterTest<DirentSpillTest> register_DirentSpillTest;
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "externalsort.h"
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <stdio.h>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  struct Number
+  {
+    unsigned value;
+
+    Number(unsigned value_ = 0)
+      : value(value_)
+      { }
+
+    bool operator< (const Number& n) const
+      { return value < n.value; }
+  };
+
+  zim::offset_type recordSize(const Number&)
+  {
+    return sizeof(Number);
+  }
+
+  void writeRecord(std::ostream& out, const Number& n)
+  {
+    out.write(reinterpret_cast<const char*>(&n.value), sizeof(n.value));
+  }
+
+  bool readRecord(std::istream& in, Number& n)
+  {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&n.value), sizeof(n.value)));
+  }
+
+  typedef zim::ExternalSorter<Number, std::less<Number> > Sorter;
+
+  const char* prefix = "externalsort-test";
+
+  void addNumbers(Sorter& sorter, unsigned count)
+  {
+    unsigned v = 1;
+    for (unsigned n = 0; n < count; ++n)
+    {
+      v = v * 1103515245 + 12345;
+      sorter.add(Number(v % 1000));
+    }
+  }
+
+  // reads all records and returns the number of records, which are not in
+  // order
+  unsigned readSorted(Sorter& sorter, unsigned& count)
+  {
+    unsigned unordered = 0;
+    Number last;
+    Number n;
+    count = 0;
+    while (sorter.next(n))
+    {
+      if (n < last)
+        ++unordered;
+      last = n;
+      ++count;
+    }
+    return unordered;
+  }
+}
+
+class ExternalSortTest : public cxxtools::unit::TestSuite
+{
+  public:
+    ExternalSortTest()
+      : cxxtools::unit::TestSuite("zim::ExternalSortTest")
+    {
+      registerMethod("SortInMemory", *this, &ExternalSortTest::SortInMemory);
+      registerMethod("SortSpilled", *this, &ExternalSortTest::SortSpilled);
+      registerMethod("MergeFanIn", *this, &ExternalSortTest::MergeFanIn);
+      registerMethod("TruncatedRun", *this, &ExternalSortTest::TruncatedRun);
+    }
+
+    void SortInMemory()
+    {
+      Sorter sorter(prefix, 1000000);
+      addNumbers(sorter, 1000);
+      sorter.sort();
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(sorter.getRunCount(), 0);
+
+      unsigned count;
+      CXXTOOLS_UNIT_ASSERT_EQUALS(readSorted(sorter, count), 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(count, 1000);
+    }
+
+    void SortSpilled()
+    {
+      Sorter sorter(prefix, 10 * sizeof(Number));
+      addNumbers(sorter, 1000);
+      sorter.sort();
+
+      CXXTOOLS_UNIT_ASSERT(sorter.getRunCount() > 1);
+
+      unsigned count;
+      CXXTOOLS_UNIT_ASSERT_EQUALS(readSorted(sorter, count), 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(count, 1000);
+    }
+
+    void MergeFanIn()
+    {
+      Sorter sorter(prefix, 10 * sizeof(Number));
+      sorter.setMaxMerge(3);
+      addNumbers(sorter, 1000);
+
+      CXXTOOLS_UNIT_ASSERT(sorter.getRunCount() > 3);
+
+      sorter.sort();
+
+      CXXTOOLS_UNIT_ASSERT(sorter.getRunCount() <= 3);
+
+      unsigned count;
+      CXXTOOLS_UNIT_ASSERT_EQUALS(readSorted(sorter, count), 0);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(count, 1000);
+    }
+
+    void TruncatedRun()
+    {
+      Sorter sorter(prefix, 10 * sizeof(Number));
+      addNumbers(sorter, 100);
+
+      // append an incomplete record to the first run
+      std::string fname = std::string(prefix) + ".0";
+      std::ofstream out(fname.c_str(), std::ios::out | std::ios::binary | std::ios::app);
+      out.put('x');
+      out.close();
+
+      sorter.sort();
+
+      unsigned count;
+      CXXTOOLS_UNIT_ASSERT_THROW(readSorted(sorter, count), std::runtime_error);
+    }
+
+};
+
+cxxtools::unit::RegisterTest<ExternalSortTest> register_ExternalSortTest;
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "localityorder.h"
+#include <zim/blob.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  class TestArticle : public zim::writer::Article
+  {
+      char ns;
+      std::string url;
+      std::string mimeType;
+      std::string data;
+      std::string dataPath;
+
+    public:
+      TestArticle(char ns_, const std::string& url_, const std::string& mimeType_,
+                  const std::string& data_, const std::string& dataPath_ = std::string())
+        : ns(ns_),
+          url(url_),
+          mimeType(mimeType_),
+          data(data_),
+          dataPath(dataPath_)
+          { }
+
+      virtual std::string getAid() const        { return std::string(1, ns) + '/' + url; }
+      virtual char getNamespace() const         { return ns; }
+      virtual std::string getUrl() const        { return url; }
+      virtual std::string getTitle() const      { return url; }
+      virtual std::string getMimeType() const   { return mimeType; }
+      virtual zim::Blob getData() const         { return zim::Blob(data.data(), data.size()); }
+      virtual std::string getDataPath() const   { return dataPath; }
+  };
+
+  class TestSource : public zim::writer::ArticleSource
+  {
+      std::vector<TestArticle> articles;
+      unsigned next;
+
+    public:
+      TestSource()
+        : next(0)
+        { }
+
+      void add(const TestArticle& article)  { articles.push_back(article); }
+
+      virtual const zim::writer::Article* getNextArticle()
+        { return next < articles.size() ? &articles[next++] : 0; }
+  };
+
+  std::vector<std::string> links(const std::string& pageUrl, const std::string& html)
+  {
+    std::vector<std::string> ret;
+    zim::writer::LocalityOrder::extractLinks(pageUrl, html.data(), html.size(), ret);
+    return ret;
+  }
+}
+
+class LocalityOrderTest : public cxxtools::unit::TestSuite
+{
+  public:
+    LocalityOrderTest()
+      : cxxtools::unit::TestSuite("zim::LocalityOrderTest")
+    {
+      registerMethod("ResolveLink", *this, &LocalityOrderTest::ResolveLink);
+      registerMethod("ResolveExternalLink", *this, &LocalityOrderTest::ResolveExternalLink);
+      registerMethod("ExtractLinks", *this, &LocalityOrderTest::ExtractLinks);
+      registerMethod("Order", *this, &LocalityOrderTest::Order);
+    }
+
+    void ResolveLink()
+    {
+      using zim::writer::LocalityOrder;
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "other.html"), "A/other.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/dir/page.html", "other.html"), "A/dir/other.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/dir/page.html", "./other.html"), "A/dir/other.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "../I/logo.png"), "I/logo.png");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/dir/page.html", "../../I/m/logo.png"), "I/m/logo.png");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/dir/page.html", "/-/style.css"), "-/style.css");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "other.html?action=edit"), "A/other.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "other.html#section"), "A/other.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "My%20Page.html"), "A/My Page.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "dir/a:b.html"), "A/dir/a:b.html");
+    }
+
+    void ResolveExternalLink()
+    {
+      using zim::writer::LocalityOrder;
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "http://example.com/x.html"), "");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "mailto:someone@example.com"), "");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "//example.com/x.html"), "");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", "#top"), "");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(LocalityOrder::resolveLink("A/page.html", ""), "");
+    }
+
+    void ExtractLinks()
+    {
+      std::vector<std::string> l = links("A/dir/page.html",
+        "<a href=\"other.html#x\">other</a>"
+        "<img src='../../I/logo.png'/>"
+        "<a href=\"http://example.com/\">external</a>"
+        "<a href=unquoted.html>unquoted</a>"
+        "<link href='/-/s.css'/>");
+
+      // the href attributes are found before the src attributes
+      CXXTOOLS_UNIT_ASSERT_EQUALS(l.size(), 3);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(l[0], "A/dir/other.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(l[1], "-/s.css");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(l[2], "I/logo.png");
+
+      // an unterminated value is ignored
+      l = links("A/page.html", "<a href=\"other.html");
+      CXXTOOLS_UNIT_ASSERT(l.empty());
+    }
+
+    void Order()
+    {
+      // a file with data larger than the asset size must not be moved
+      // behind the page, even when its data is not held in memory
+      std::string name = std::tmpnam(NULL);
+      std::ofstream os(name.c_str());
+      os << std::string(1000, 'x');
+      os.close();
+
+      TestSource source;
+      source.add(TestArticle('A', "p1.html", "text/html",
+        "<img src=\"../I/small.png\"/><img src=\"../I/large.png\"/>"));
+      source.add(TestArticle('A', "p2.html", "text/html", "<p>no links</p>"));
+      source.add(TestArticle('I', "small.png", "image/png", "small"));
+      source.add(TestArticle('I', "large.png", "image/png", std::string(), name));
+
+      zim::writer::LocalityOrder order(source, 100);
+      std::vector<std::string> urls;
+      const zim::writer::Article* a;
+      while ((a = order.getNextArticle()) != 0)
+        urls.push_back(a->getUrl());
+
+      std::remove(name.c_str());
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(urls.size(), 4);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(urls[0], "p1.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(urls[1], "small.png");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(urls[2], "p2.html");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(urls[3], "large.png");
+    }
+
+};
+
+cxxtools::unit::RegisterTest<LocalityOrderTest> register_LocalityOrderTest;
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "md5writer.h"
+#include "md5.h"
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  // more than the 4 blocks of 1 MB, so that the writer has to wait for
+  // the hashing thread
+  std::string testData()
+  {
+    std::string data;
+    data.reserve(5 * 1024 * 1024 + 4711);
+    for (unsigned n = 0; data.size() < 5 * 1024 * 1024 + 4711; ++n)
+      data += static_cast<char>(n * 7 + n / 251);
+    return data;
+  }
+
+  std::string md5(const std::string& data)
+  {
+    zim_MD5_CTX ctx;
+    zim_MD5Init(&ctx);
+    zim_MD5Update(&ctx, reinterpret_cast<const unsigned char*>(data.data()), data.size());
+    unsigned char digest[16];
+    zim_MD5Final(digest, &ctx);
+    return std::string(reinterpret_cast<char*>(digest), 16);
+  }
+
+  std::string digest(zim::Md5Writer& writer)
+  {
+    unsigned char digest[16];
+    writer.getDigest(digest);
+    return std::string(reinterpret_cast<char*>(digest), 16);
+  }
+
+  // writes the data in pieces of different sizes and single characters
+  void write(std::ostream& out, const std::string& data)
+  {
+    std::string::size_type pos = 0;
+    for (unsigned n = 0; pos < data.size(); ++n)
+    {
+      if (n % 3 == 0)
+        out.put(data[pos++]);
+      else
+      {
+        std::string::size_type count = std::min(data.size() - pos,
+                                                std::string::size_type(n * 997 % 300000));
+        out.write(data.data() + pos, count);
+        pos += count;
+      }
+    }
+  }
+}
+
+class Md5WriterTest : public cxxtools::unit::TestSuite
+{
+  public:
+    Md5WriterTest()
+      : cxxtools::unit::TestSuite("zim::Md5WriterTest")
+    {
+      registerMethod("HashOnly", *this, &Md5WriterTest::HashOnly);
+      registerMethod("Target", *this, &Md5WriterTest::Target);
+      registerMethod("Empty", *this, &Md5WriterTest::Empty);
+    }
+
+    void HashOnly()
+    {
+      std::string data = testData();
+      zim::Md5Writer writer;
+      write(writer, data);
+      CXXTOOLS_UNIT_ASSERT(writer);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(writer.tellp(), std::streampos(data.size()));
+      CXXTOOLS_UNIT_ASSERT(digest(writer) == md5(data));
+    }
+
+    void Target()
+    {
+      std::string data = testData();
+      std::ostringstream out;
+      zim::Md5Writer writer(out);
+      write(writer, data);
+      CXXTOOLS_UNIT_ASSERT(writer);
+      CXXTOOLS_UNIT_ASSERT(digest(writer) == md5(data));
+      CXXTOOLS_UNIT_ASSERT(out.str() == data);
+    }
+
+    void Empty()
+    {
+      zim::Md5Writer writer;
+      CXXTOOLS_UNIT_ASSERT(digest(writer) == md5(std::string()));
+    }
+
+};
+
+cxxtools::unit::RegisterTest<Md5WriterTest> register_Md5WriterTest;
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "parallelsort.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  std::vector<unsigned> randomNumbers(unsigned count)
+  {
+    std::vector<unsigned> v;
+    unsigned r = 1;
+    for (unsigned n = 0; n < count; ++n)
+    {
+      r = r * 1103515245 + 12345;
+      v.push_back(r % 100000);
+    }
+    return v;
+  }
+}
+
+class ParallelSortTest : public cxxtools::unit::TestSuite
+{
+  public:
+    ParallelSortTest()
+      : cxxtools::unit::TestSuite("zim::ParallelSortTest")
+    {
+      registerMethod("SortSmall", *this, &ParallelSortTest::SortSmall);
+      registerMethod("SortThreads", *this, &ParallelSortTest::SortThreads);
+      registerMethod("SortOddThreads", *this, &ParallelSortTest::SortOddThreads);
+    }
+
+    void SortSmall()
+    {
+      std::vector<unsigned> v = randomNumbers(1000);
+      std::vector<unsigned> expected = v;
+      std::sort(expected.begin(), expected.end());
+
+      zim::parallelSort(v.begin(), v.end(), std::less<unsigned>(), 8);
+
+      CXXTOOLS_UNIT_ASSERT(v == expected);
+    }
+
+    void SortThreads()
+    {
+      std::vector<unsigned> v = randomNumbers(200000);
+      std::vector<unsigned> expected = v;
+      std::sort(expected.begin(), expected.end());
+
+      zim::parallelSort(v.begin(), v.end(), std::less<unsigned>(), 8);
+
+      CXXTOOLS_UNIT_ASSERT(v == expected);
+    }
+
+    void SortOddThreads()
+    {
+      std::vector<unsigned> v = randomNumbers(100001);
+      std::vector<unsigned> expected = v;
+      std::sort(expected.begin(), expected.end(), std::greater<unsigned>());
+
+      zim::parallelSort(v.begin(), v.end(), std::greater<unsigned>(), 3);
+
+      CXXTOOLS_UNIT_ASSERT(v == expected);
+    }
+
+};
+
+cxxtools::unit::RegisterTest<ParallelSortTest> register_ParallelSortTest;
@@ -34,6 +34,7 @@ class TemplateTest : public cxxtools::unit::TestSuite, private zim::TemplatePars
       registerMethod("ZeroTemplate", *this, &TemplateTest::ZeroTemplate);
       registerMethod("Token", *this, &TemplateTest::Token);
       registerMethod("Link", *this, &TemplateTest::Link);
+      registerMethod("Compiled", *this, &TemplateTest::Compiled);
     }
 
     void setUp()
@@ -69,6 +70,25 @@ class TemplateTest : public cxxtools::unit::TestSuite, private zim::TemplatePars
       CXXTOOLS_UNIT_ASSERT_EQUALS(result, "<html>L(A, Article)</html>");
     }
 
+    void Compiled()
+    {
+      std::string t = "<html><%title%><%foo%><%/A/Article%></html>";
+      zim::CompiledTemplate tmpl(t.data(), t.size());
+      const zim::CompiledTemplate::Ops& ops = tmpl.getOps();
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(ops.size(), 5);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(ops[0].type, zim::CompiledTemplate::opData);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(tmpl.getText(ops[0]), ops[0].size), "<html>");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(ops[1].type, zim::CompiledTemplate::opTitle);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(ops[2].type, zim::CompiledTemplate::opToken);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(tmpl.getText(ops[2]), ops[2].size), "foo");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(ops[3].type, zim::CompiledTemplate::opLink);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(ops[3].ns, 'A');
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(tmpl.getText(ops[3]), ops[3].size), "Article");
+      CXXTOOLS_UNIT_ASSERT_EQUALS(ops[4].type, zim::CompiledTemplate::opData);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(std::string(tmpl.getText(ops[4]), ops[4].size), "</html>");
+    }
+
   private:
     void onData(const std::string& data)
     {
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 Tommi Maekitalo
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * is provided AS IS, WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, and
+ * NON-INFRINGEMENT.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#include "titlekey.h"
+#include <algorithm>
+#include <vector>
+
+#include <cxxtools/unit/testsuite.h>
+#include <cxxtools/unit/registertest.h>
+
+namespace
+{
+  // orders like the title index: by namespace, title and index
+  class CompareReference
+  {
+      const std::vector<zim::writer::Dirent>& dirents;
+
+    public:
+      explicit CompareReference(const std::vector<zim::writer::Dirent>& dirents_)
+        : dirents(dirents_)
+        { }
+
+      bool operator() (const zim::writer::TitleKey& k1, const zim::writer::TitleKey& k2) const
+      {
+        const zim::writer::Dirent& d1 = dirents[k1.idx];
+        const zim::writer::Dirent& d2 = dirents[k2.idx];
+        if (d1.getNamespace() != d2.getNamespace())
+          return d1.getNamespace() < d2.getNamespace();
+        int c = d1.getTitle().compare(d2.getTitle());
+        return c < 0 || (c == 0 && k1.idx < k2.idx);
+      }
+  };
+
+  void addDirent(std::vector<zim::writer::Dirent>& dirents, char ns, const std::string& title)
+  {
+    zim::writer::Dirent dirent(ns, title);
+    dirents.push_back(dirent);
+  }
+}
+
+class TitleKeyTest : public cxxtools::unit::TestSuite
+{
+  public:
+    TitleKeyTest()
+      : cxxtools::unit::TestSuite("zim::TitleKeyTest")
+    {
+      registerMethod("CompareTitle", *this, &TitleKeyTest::CompareTitle);
+    }
+
+    void CompareTitle()
+    {
+      std::vector<zim::writer::Dirent> dirents;
+      addDirent(dirents, 'A', "abcdefgh2");
+      addDirent(dirents, 'A', "abcdefgh1");
+      addDirent(dirents, 'A', "abcdefg");
+      addDirent(dirents, 'A', "abcdefgh1");
+      addDirent(dirents, 'A', "abc");
+      addDirent(dirents, 'A', std::string("abc\0", 4));
+      addDirent(dirents, 'A', "ab");
+      addDirent(dirents, 'A', "\xc3\xa4rger");
+      addDirent(dirents, 'A', "zebra");
+      addDirent(dirents, 'A', "");
+      addDirent(dirents, 'B', "abc");
+      addDirent(dirents, 'I', "abcdefgh0");
+      addDirent(dirents, '-', "zebra");
+      addDirent(dirents, '\xe4', "abc");
+
+      std::vector<zim::writer::TitleKey> keys;
+      for (unsigned n = 0; n < dirents.size(); ++n)
+        keys.push_back(zim::writer::TitleKey(dirents[n], n));
+
+      std::vector<zim::writer::TitleKey> expected = keys;
+      std::sort(expected.begin(), expected.end(), CompareReference(dirents));
+
+      std::reverse(keys.begin(), keys.end());
+      std::sort(keys.begin(), keys.end(), zim::writer::CompareTitle(dirents));
+
+      CXXTOOLS_UNIT_ASSERT_EQUALS(keys.size(), expected.size());
+      for (unsigned n = 0; n < keys.size(); ++n)
+        CXXTOOLS_UNIT_ASSERT_EQUALS(keys[n].idx, expected[n].idx);
+
+      // equal titles are ordered by index
+      CXXTOOLS_UNIT_ASSERT_EQUALS(keys[7].idx, 1);
+      CXXTOOLS_UNIT_ASSERT_EQUALS(keys[8].idx, 3);
+    }
+
+};
+
+cxxtools::unit::RegisterTest<TitleKeyTest> register_TitleKeyTest;
@@ -42,6 +42,17 @@ int create(int argc, char* argv[], zim::writer::ArticleSource& articleSource)
                  "\n"
                  "options:\n"
                  "\t-s <number>       specify chunk size for compression in kB (default 1024)\n"
+                 "\t--compress-threads <number>  number of threads for compression (default: number of processors)\n"
+                 "\t--classic-layout  write the directory before the clusters using a temporary file\n"
+                 "\t--cluster-checksums  store a CRC32C checksum of each cluster\n"
+                 "\t--dedup-memory <MB>  memory for finding identical blobs, which are stored once;\n"
+                 "\t                  only for trusted content, since blobs are identified by md5 sum (default 0: off)\n"
+                 "\t--cluster-groups <number>  compressed clusters filled at the same time, grouped by mime type (default 1)\n"
+                 "\t--similarity-buckets <number>  groups of similar content per mime type (default 0: off)\n"
+                 "\t--locality        place html pages and their assets into the same cluster\n"
+                 "\t--large-blob-size <kB>  store larger blobs in clusters of their own (default 0: off)\n"
+                 "\t--min-saving <percent>  store clusters uncompressed, which get less smaller (default 0: off)\n"
+                 "\t--fast-codec-tolerance <percent>  use zlib, when its result is at most that much larger (default 0: off)\n"
                  "\t--db <dburl>      specify a db source (default: postgresql:dbname=zim, tntdb is used here)\n"
                  "\t-Z <articlefile>  create a fulltext index for specified article\n"
                  "\t-S <words>        search in zim file for articles\n"
@@ -250,6 +250,15 @@ zim::Blob FileArticle::getData() const {
 }
 
 
+/* HTML and CSS content is rewritten; all other files are copied
+   unchanged, so the writer may read them itself */
+std::string FileArticle::getDataPath() const {
+    if ( dataRead || getMimeType().find("text/css") == 0 )
+        return std::string();
+
+    return directoryPath + "/" + aid;
+}
+
 MetadataArticle::MetadataArticle(const std::string &id) {
     aid = "/M/"+id;
     mimeType = "text/plain";
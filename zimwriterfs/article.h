@@ -93,6 +93,7 @@ class FileArticle : public Article {
   public:
     explicit FileArticle(const std::string& id, const bool detectRedirects = true);
     virtual zim::Blob getData() const;
+    virtual std::string getDataPath() const;
 };
 
 